@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Generics/Map.h"
+#include "Generics/Tree.h"
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace Generics {
+  namespace Detail {
+    template<class T, class = void>
+      struct HasEqualityOperator : std::false_type {};
+
+    template<class T>
+      struct HasEqualityOperator<T, std::void_t<decltype(std::declval<T const&>() == std::declval<T const&>())>>
+      : std::true_type {};
+
+    // The operator== of std::pair is declared for any pair and only fails
+    // to compile once called, so pairs are looked into.
+    template<class T>
+      struct IsEqualityComparable : HasEqualityOperator<T> {};
+
+    template<class First, class Second>
+      struct IsEqualityComparable<std::pair<First, Second>>
+      : std::conjunction<IsEqualityComparable<First>, IsEqualityComparable<Second>> {};
+
+
+    // What an in-order walk of a tree has left: a stack of subtrees still
+    // to walk whole and of nodes whose own value comes next, the front on
+    // top. Expanding a subtree replaces it by its left subtree, its root and
+    // its right subtree, so the stack holds at most two entries per level.
+    template<class TreeType>
+      class Frontier {
+        using Node = typename TreeType::Node;
+
+        struct Entry {
+          Node const* node;
+          bool whole;
+        };
+
+        Entry entries_[2 * TreeType::MaxHeight + 1];
+        std::size_t depth_{0};
+
+        void push_whole(TreeType const& tree) noexcept {
+          if (!tree.empty()) {
+            entries_[depth_++] = {tree.node().get(), true};
+          }
+        }
+
+      public:
+        explicit Frontier(TreeType const& tree) noexcept {
+          push_whole(tree);
+        }
+
+        bool empty() const noexcept { return depth_ == 0; }
+        Entry const& top() const noexcept { return entries_[depth_ - 1]; }
+        void pop() noexcept { --depth_; }
+
+        // Precondition: the top is a whole subtree.
+        void expand() noexcept {
+          auto const* node = entries_[--depth_].node;
+          push_whole(node->right);
+          entries_[depth_++] = {node, false};
+          push_whole(node->left);
+        }
+      };
+  } // Detail
+
+
+  // Calls removed with every value of before that after lacks and added with
+  // every value of after that before lacks, merged in ascending order. Two
+  // equal values held by different nodes count as a removal and an addition
+  // when T has an operator== that tells them apart, like the entries of a
+  // Map whose value changed.
+  //
+  // Subtrees both versions share are skipped without a look inside, so
+  // versions a few edits apart take O(edits * log n) time.
+  template<class T, class... Options, class OnRemoved, class OnAdded>
+    void Diff(
+        Tree<T, Options...> const& before, Tree<T, Options...> const& after,
+        OnRemoved&& removed, OnAdded&& added
+    ) {
+      using TreeType = Tree<T, Options...>;
+      Detail::Frontier<TreeType> lhs{before};
+      Detail::Frontier<TreeType> rhs{after};
+      while (!lhs.empty() && !rhs.empty()) {
+        const auto left = lhs.top();
+        const auto right = rhs.top();
+        if (left.node == right.node && left.whole && right.whole) {
+          lhs.pop();
+          rhs.pop();
+        }
+        else if (left.whole || right.whole) {
+          // Expanding the higher subtree first gives the lower one the
+          // chance to meet itself among its parts.
+          const auto left_height = left.whole ? left.node->black_height : 0;
+          const auto right_height = right.whole ? right.node->black_height : 0;
+          if (left.whole && left_height >= right_height) {
+            lhs.expand();
+          }
+          if (right.whole && right_height >= left_height) {
+            rhs.expand();
+          }
+        }
+        else if (Detail::Less<TreeType>(left.node->value, right.node->value)) {
+          removed(left.node->value);
+          lhs.pop();
+        }
+        else if (Detail::Less<TreeType>(right.node->value, left.node->value)) {
+          added(right.node->value);
+          rhs.pop();
+        }
+        else {
+          if constexpr (Detail::IsEqualityComparable<T>::value) {
+            if (left.node != right.node && !(left.node->value == right.node->value)) {
+              removed(left.node->value);
+              added(right.node->value);
+            }
+          }
+          lhs.pop();
+          rhs.pop();
+        }
+      }
+
+      for (; !lhs.empty(); lhs.pop()) {
+        while (lhs.top().whole) {
+          lhs.expand();
+        }
+        removed(lhs.top().node->value);
+      }
+      for (; !rhs.empty(); rhs.pop()) {
+        while (rhs.top().whole) {
+          rhs.expand();
+        }
+        added(rhs.top().node->value);
+      }
+    }
+
+
+  // The entries removed and added between two versions of a map; a changed
+  // value shows as both.
+  template<class K, class V, class Compare, class RefCounting, class OnRemoved, class OnAdded>
+    void Diff(
+        Map<K, V, Compare, RefCounting> const& before, Map<K, V, Compare, RefCounting> const& after,
+        OnRemoved&& removed, OnAdded&& added
+    ) {
+      Diff(before.entries(), after.entries(), std::forward<OnRemoved>(removed), std::forward<OnAdded>(added));
+    }
+} // Generics
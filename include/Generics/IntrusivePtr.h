@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#if __has_include(<sys/single_threaded.h>)
+#include <sys/single_threaded.h>
+#endif
+
+namespace Generics {
+  // Reference counts of nodes shared between threads. Like std::shared_ptr
+  // with libstdc++, they fall back to plain arithmetic as long as the C library
+  // tells that the process has never started a second thread.
+  struct AtomicRefCount {
+    using Counter = std::atomic<std::uint32_t>;
+
+    static bool SingleThreaded() noexcept {
+#if __has_include(<sys/single_threaded.h>)
+      return __libc_single_threaded;
+#else
+      return false;
+#endif
+    }
+
+    static void Increment(Counter& counter) noexcept {
+      if (SingleThreaded()) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      }
+      else {
+        counter.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    // True when the last reference is gone.
+    static bool Decrement(Counter& counter) noexcept {
+      if (SingleThreaded()) {
+        const auto left = counter.load(std::memory_order_relaxed) - 1;
+        counter.store(left, std::memory_order_relaxed);
+        return left == 0;
+      }
+      else {
+        return counter.fetch_sub(1, std::memory_order_acq_rel) == 1;
+      }
+    }
+
+    // True when the holder of a reference holds the only one. Acquiring makes
+    // whatever the holders of dropped references wrote visible.
+    static bool Unique(Counter const& counter) noexcept {
+      return counter.load(std::memory_order_acquire) == 1;
+    }
+  };
+
+
+  // Plain counts for structures that never cross threads, which spares every
+  // copy of a pointer the atomic increment.
+  struct LocalRefCount {
+    using Counter = std::uint32_t;
+
+    static void Increment(Counter& counter) noexcept {
+      ++counter;
+    }
+
+    static bool Decrement(Counter& counter) noexcept {
+      return --counter == 0;
+    }
+
+    static bool Unique(Counter const& counter) noexcept {
+      return counter == 1;
+    }
+  };
+
+
+  // Owning pointer to an object that counts its own references. The pointee's
+  // namespace provides Retain(pointer) and Release(pointer), the latter also
+  // destroying the object when it drops the last reference.
+  template<class Object>
+    class IntrusivePtr {
+      Object* object_{nullptr};
+
+      explicit IntrusivePtr(Object* object) noexcept : object_{object} {}
+
+    public:
+      IntrusivePtr() = default;
+      IntrusivePtr(std::nullptr_t) noexcept {}
+
+      // Takes over a reference the caller holds, like the initial one of a
+      // newly created object.
+      static IntrusivePtr Adopt(Object* object) noexcept {
+        return IntrusivePtr{object};
+      }
+
+      IntrusivePtr(IntrusivePtr const& other) noexcept
+      : object_{other.object_} {
+        if (object_) {
+          Retain(object_);
+        }
+      }
+
+      IntrusivePtr(IntrusivePtr&& other) noexcept
+      : object_{std::exchange(other.object_, nullptr)} {}
+
+      IntrusivePtr& operator=(IntrusivePtr other) noexcept {
+        std::swap(object_, other.object_);
+        return *this;
+      }
+
+      ~IntrusivePtr() {
+        if (object_) {
+          Release(object_);
+        }
+      }
+
+      void reset() noexcept {
+        IntrusivePtr{}.swap(*this);
+      }
+
+      void swap(IntrusivePtr& other) noexcept {
+        std::swap(object_, other.object_);
+      }
+
+      Object* get() const noexcept { return object_; }
+      Object& operator*() const noexcept { return *object_; }
+      Object* operator->() const noexcept { return object_; }
+      explicit operator bool() const noexcept { return object_ != nullptr; }
+
+      bool operator==(IntrusivePtr const& rhs) const noexcept { return object_ == rhs.object_; }
+      bool operator!=(IntrusivePtr const& rhs) const noexcept { return object_ != rhs.object_; }
+    };
+} // Generics
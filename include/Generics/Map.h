@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Generics/Tree.h"
+#include <functional>
+#include <initializer_list>
+#include <utility>
+
+namespace Generics {
+  // Persistent map from K to V: a Tree of key-value pairs ordered by their
+  // keys, sharing everything with the versions it came from the same way.
+  template<class K, class V, class Compare = std::less<K>, class RefCounting = AtomicRefCount>
+    class Map {
+    public:
+      using key_type = K;
+      using mapped_type = V;
+      using value_type = std::pair<K, V>;
+      using key_compare = Compare;
+
+      // Orders entries and keys alike by Compare on the keys.
+      struct EntryCompare {
+        using is_transparent = void;
+
+        static K const& KeyOf(value_type const& entry) noexcept { return entry.first; }
+
+        template<class Key>
+          static Key const& KeyOf(Key const& key) noexcept { return key; }
+
+        template<class Lhs, class Rhs>
+          bool operator()(Lhs const& lhs, Rhs const& rhs) const {
+            return Compare{}(KeyOf(lhs), KeyOf(rhs));
+          }
+      };
+
+      using TreeType = Tree<value_type, EntryCompare, RefCounting>;
+      using Iterator = typename TreeType::Iterator;
+      using iterator = Iterator;
+      using const_iterator = Iterator;
+
+    private:
+      TreeType entries_;
+
+    public:
+      Map() = default;
+      explicit Map(TreeType entries) noexcept : entries_{std::move(entries)} {}
+
+      // Keeps the first of entries with equal keys.
+      Map(std::initializer_list<value_type> entries)
+      : entries_(entries.begin(), entries.end()) {}
+
+      template<class InputIterator>
+        Map(InputIterator begin, InputIterator end) : entries_(begin, end) {}
+
+      bool empty() const noexcept { return entries_.empty(); }
+      TreeType const& entries() const noexcept { return entries_; }
+
+      Iterator begin() const noexcept { return entries_.begin(); }
+      Iterator end() const noexcept { return entries_.end(); }
+
+      // The first entry whose key is not less than key.
+      template<class Key>
+        Iterator lower_bound(Key const& key) const {
+          typename Detail::LookupKey<Compare, K, Key>::Type const& lookup = key;
+          return entries_.lower_bound(lookup);
+        }
+
+      // The first entry whose key is greater than key.
+      template<class Key>
+        Iterator upper_bound(Key const& key) const {
+          typename Detail::LookupKey<Compare, K, Key>::Type const& lookup = key;
+          return entries_.upper_bound(lookup);
+        }
+
+      bool operator==(Map const& rhs) const { return entries_ == rhs.entries_; }
+      bool operator!=(Map const& rhs) const { return entries_ != rhs.entries_; }
+    };
+
+
+  // The value under key, or nullptr.
+  template<class K, class V, class Compare, class RefCounting, class Key>
+    V const* Find(Map<K, V, Compare, RefCounting> const& map, Key const& key) {
+      typename Detail::LookupKey<Compare, K, Key>::Type const& lookup = key;
+      auto const* entry = Find(map.entries(), lookup);
+      return entry ? &entry->second : nullptr;
+    }
+
+
+  template<class K, class V, class Compare, class RefCounting, class Key>
+    bool Has(Map<K, V, Compare, RefCounting> const& map, Key const& key) {
+      return Find(map, key) != nullptr;
+    }
+
+
+  // The map with key mapped to value, whether it was there or not.
+  template<class K, class V, class Compare, class RefCounting>
+    Map<K, V, Compare, RefCounting> Assigned(
+        Map<K, V, Compare, RefCounting> const& map,
+        typename Map<K, V, Compare, RefCounting>::key_type key,
+        typename Map<K, V, Compare, RefCounting>::mapped_type value
+    ) {
+      return Map<K, V, Compare, RefCounting>{
+          Assigned(map.entries(), std::pair<K, V>{std::move(key), std::move(value)})
+      };
+    }
+
+
+  // Returns the same map when key is not there.
+  template<class K, class V, class Compare, class RefCounting, class Key>
+    Map<K, V, Compare, RefCounting> Removed(Map<K, V, Compare, RefCounting> const& map, Key const& key) {
+      typename Detail::LookupKey<Compare, K, Key>::Type const& lookup = key;
+      return Map<K, V, Compare, RefCounting>{Removed(map.entries(), lookup)};
+    }
+} // Generics
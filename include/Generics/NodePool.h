@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace Generics {
+  // Fixed size memory for the nodes of one type. Every thread keeps a free
+  // list of its own, so allocating and freeing take no lock and reuse memory
+  // that is likely still in cache. Memory comes in chunks of ChunkSize nodes
+  // that are never given back to the system, but it is bounded: a thread
+  // holding more than MaxFree free nodes passes ChunkSize of them to a
+  // shared list, as does a thread that ends with all of its own, and new
+  // chunks are only made once that list is empty. A thread that frees what
+  // another allocates hands its nodes back that way, and the pool never
+  // holds much more than the most nodes ever alive plus MaxFree per thread.
+  //
+  // A node may be freed on another thread than the one that allocated it.
+  template<class Node>
+    class NodePool {
+      union Slot {
+        Slot* next;
+        alignas(Node) unsigned char storage[sizeof(Node)];
+      };
+
+      static constexpr std::size_t ChunkSize{256};
+      static constexpr std::size_t MaxFree{2 * ChunkSize};
+
+      // All of these are trivially destructible, so nodes freed while statics
+      // are destroyed at exit still find them.
+      static inline std::atomic_flag orphans_lock_ = ATOMIC_FLAG_INIT;
+      static inline Slot* orphans_{nullptr};
+      static inline thread_local Slot* free_{nullptr};
+      static inline thread_local std::size_t free_count_{0};
+      static inline thread_local bool exited_{false};
+
+      struct ExitGuard {
+        ~ExitGuard() {
+          exited_ = true;
+          free_count_ = 0;
+          if (auto* slots = std::exchange(free_, nullptr)) {
+            std::size_t count{SIZE_MAX};
+            Orphaned(slots, Cut(slots, count));
+          }
+        }
+      };
+
+      // The count-th slot of the list, or its last one when it is shorter;
+      // count becomes the number of slots up to it.
+      static Slot* Cut(Slot* slots, std::size_t& count) noexcept {
+        std::size_t n{1};
+        for (; n < count && slots->next; ++n) {
+          slots = slots->next;
+        }
+        count = n;
+        return slots;
+      }
+
+      static void Orphaned(Slot* first, Slot* last) noexcept {
+        while (orphans_lock_.test_and_set(std::memory_order_acquire)) {}
+        last->next = orphans_;
+        orphans_ = first;
+        orphans_lock_.clear(std::memory_order_release);
+      }
+
+      static void Guard() {
+        static thread_local ExitGuard guard;
+      }
+
+      static void Refill() {
+        Guard();
+        while (orphans_lock_.test_and_set(std::memory_order_acquire)) {}
+        if (orphans_) {
+          std::size_t count{ChunkSize};
+          auto* last = Cut(orphans_, count);
+          free_ = std::exchange(orphans_, last->next);
+          last->next = nullptr;
+          free_count_ = count;
+        }
+        orphans_lock_.clear(std::memory_order_release);
+        if (free_) {
+          return;
+        }
+
+        auto* chunk = static_cast<Slot*>(::operator new(sizeof(Slot) * ChunkSize));
+        for (std::size_t i = 0; i + 1 < ChunkSize; ++i) {
+          chunk[i].next = &chunk[i + 1];
+        }
+        chunk[ChunkSize - 1].next = nullptr;
+        free_ = chunk;
+        free_count_ = ChunkSize;
+      }
+
+    public:
+      // Uninitialised memory for one Node.
+      static void* Allocate() {
+        if (!free_) {
+          Refill();
+        }
+        auto* slot = free_;
+        free_ = slot->next;
+        --free_count_;
+        return slot->storage;
+      }
+
+      static void Deallocate(void* memory) noexcept {
+        auto* slot = reinterpret_cast<Slot*>(memory);
+        if (exited_) {
+          Orphaned(slot, slot);
+        }
+        else {
+          if (!free_) {
+            Guard();
+          }
+          slot->next = free_;
+          free_ = slot;
+          if (++free_count_ > MaxFree) {
+            // The most recently freed nodes stay, as they are the likeliest
+            // to be in cache.
+            std::size_t kept{free_count_ - ChunkSize};
+            auto* last_kept = Cut(free_, kept);
+            auto* first = std::exchange(last_kept->next, nullptr);
+            std::size_t given{ChunkSize};
+            Orphaned(first, Cut(first, given));
+            free_count_ -= ChunkSize;
+          }
+        }
+      }
+    };
+} // Generics
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Generics/ThreadPool.h"
+#include "Generics/Tree.h"
+#include <cstddef>
+#include <utility>
+
+namespace Generics {
+  // Algorithms that split a tree at its root and hand the two subtrees to a
+  // ThreadPool. Trees are immutable and walking them touches no reference
+  // count, so the threads share them without any locking.
+  namespace Detail {
+    // Subtrees lower than this, of up to a few thousand values, are walked
+    // on one thread: forking costs more than they take.
+    constexpr std::size_t SequentialBlackHeight{6};
+
+    template<class TreeType, class Result, class Combine, class Transform>
+      Result Reducing(
+          TreeType const& tree, Result const& identity,
+          Combine const& combine, Transform const& transform, ThreadPool& pool
+      ) {
+        if (tree.black_height() < SequentialBlackHeight) {
+          Result result{identity};
+          for (auto const& value : tree) {
+            result = combine(std::move(result), transform(value));
+          }
+          return result;
+        }
+        auto [left, right] = pool.both(
+            [&]() { return Reducing(tree.left(), identity, combine, transform, pool); },
+            [&]() { return Reducing(tree.right(), identity, combine, transform, pool); }
+        );
+        return combine(combine(std::move(left), transform(tree.root())), std::move(right));
+      }
+  } // Detail
+
+
+  struct Identity {
+    template<class Value>
+      Value const& operator()(Value const& value) const noexcept { return value; }
+  };
+
+
+  // Folds the transformed values in order with combine, which has to be
+  // associative with identity as its neutral element but need not be
+  // commutative.
+  template<class T, class... Options, class Result, class Combine, class Transform = Identity>
+    Result Reduce(
+        Tree<T, Options...> const& tree, Result identity, Combine combine, Transform transform = {},
+        ThreadPool& pool = ThreadPool::Shared()
+    ) {
+      return pool.run([&]() { return Detail::Reducing(tree, identity, combine, transform, pool); });
+    }
+
+
+  // Calls function with every value, on any thread and in no order.
+  template<class T, class... Options, class Function>
+    void ForEach(Tree<T, Options...> const& tree, Function function, ThreadPool& pool = ThreadPool::Shared()) {
+      struct Nothing {};
+      Reduce(tree, Nothing{},
+          [](Nothing, Nothing) { return Nothing{}; },
+          [&function](T const& value) {
+            function(value);
+            return Nothing{};
+          },
+          pool
+      );
+    }
+
+
+  template<class T, class... Options, class Predicate>
+    std::size_t CountIf(Tree<T, Options...> const& tree, Predicate predicate, ThreadPool& pool = ThreadPool::Shared()) {
+      return Reduce(tree, std::size_t{0},
+          [](std::size_t lhs, std::size_t rhs) { return lhs + rhs; },
+          [&predicate](T const& value) { return predicate(value) ? std::size_t{1} : std::size_t{0}; },
+          pool
+      );
+    }
+} // Generics
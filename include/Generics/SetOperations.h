@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Generics/ThreadPool.h"
+#include "Generics/Tree.h"
+#include <type_traits>
+#include <utility>
+
+namespace Generics {
+  enum class Execution {
+    Sequential, Parallel
+  };
+
+
+  // Set operations by splitting one tree at the root of the other and joining
+  // the results of the two halves, after Blelloch, Ferizovic and Sun, "Just
+  // Join for Parallel Ordered Sets" (SPAA 2016). They take O(m log(n/m + 1))
+  // time for trees of m <= n values. Subtrees both trees share, as two
+  // versions of one tree do, are not walked at all, and the parts of the
+  // result equal to a subtree of the first tree are that subtree.
+  namespace Detail {
+    // Trees lower than this, of less than 2^12 values, are not worth a thread.
+    constexpr std::size_t ParallelBlackHeight{12};
+
+    // How many levels of the recursion fork, enough to keep every thread of
+    // the shared pool busy.
+    inline unsigned ForkLevels(Execution execution) {
+      unsigned levels{0};
+      if (execution == Execution::Parallel) {
+        for (auto threads = ThreadPool::Shared().size(); threads > 1; threads = (threads + 1) / 2) {
+          ++levels;
+        }
+      }
+      return levels;
+    }
+
+
+    // Runs both on this thread, or forks them on the shared pool.
+    template<class Left, class Right>
+      auto BothOf(bool forked, Left const& left, Right const& right) {
+        if (forked) {
+          return ThreadPool::Shared().both(left, right);
+        }
+        else {
+          auto left_result = left();
+          return std::make_pair(std::move(left_result), right());
+        }
+      }
+
+
+    // Trees with plain reference counts never leave their thread.
+    template<class TreeType>
+      bool Forks(TreeType const& tree, unsigned forks) {
+        return std::is_same_v<typename TreeType::ref_counting, AtomicRefCount>
+            && forks > 0
+            && tree.black_height() >= ParallelBlackHeight
+        ;
+      }
+
+
+    // The node of tree over left and right, which is tree itself if they are
+    // its own subtrees.
+    template<class TreeType>
+      TreeType Rejoined(TreeType const& tree, TreeType const& left, TreeType const& right) {
+        if (left == tree.left() && right == tree.right()) {
+          return tree;
+        }
+        else {
+          return Joined(left, tree.root(), right);
+        }
+      }
+
+
+    template<class TreeType>
+      TreeType Uniting(TreeType const& lhs, TreeType const& rhs, unsigned forks) {
+        if (lhs.empty()) {
+          return rhs;
+        }
+        else if (rhs.empty() || lhs == rhs) {
+          return lhs;
+        }
+        const auto parts = SplitAt(rhs, lhs.root());
+        const auto forked = Forks(lhs, forks);
+        const auto [left, right] = BothOf(forked,
+            [&]() { return Uniting(lhs.left(), parts.less, forks - forked); },
+            [&]() { return Uniting(lhs.right(), parts.greater, forks - forked); }
+        );
+        return Rejoined(lhs, left, right);
+      }
+
+
+    template<class TreeType>
+      TreeType Intersecting(TreeType const& lhs, TreeType const& rhs, unsigned forks) {
+        if (lhs.empty() || rhs.empty()) {
+          return {};
+        }
+        else if (lhs == rhs) {
+          return lhs;
+        }
+        const auto parts = SplitAt(rhs, lhs.root());
+        const auto forked = Forks(lhs, forks);
+        const auto [left, right] = BothOf(forked,
+            [&]() { return Intersecting(lhs.left(), parts.less, forks - forked); },
+            [&]() { return Intersecting(lhs.right(), parts.greater, forks - forked); }
+        );
+        return parts.found ? Rejoined(lhs, left, right) : Concatenated(left, right);
+      }
+
+
+    template<class TreeType>
+      TreeType Subtracting(TreeType const& lhs, TreeType const& rhs, unsigned forks) {
+        if (lhs.empty() || lhs == rhs) {
+          return {};
+        }
+        else if (rhs.empty()) {
+          return lhs;
+        }
+        const auto parts = SplitAt(rhs, lhs.root());
+        const auto forked = Forks(lhs, forks);
+        const auto [left, right] = BothOf(forked,
+            [&]() { return Subtracting(lhs.left(), parts.less, forks - forked); },
+            [&]() { return Subtracting(lhs.right(), parts.greater, forks - forked); }
+        );
+        return parts.found ? Concatenated(left, right) : Rejoined(lhs, left, right);
+      }
+  } // Detail
+
+
+  // The values of either tree; of two equal values, the one of lhs.
+  template<class T, class... Options>
+    Tree<T, Options...> Union(
+        Tree<T, Options...> const& lhs, Tree<T, Options...> const& rhs,
+        Execution execution = Execution::Sequential
+    ) {
+      return Detail::Uniting(lhs, rhs, Detail::ForkLevels(execution));
+    }
+
+
+  // The values of lhs that rhs has too.
+  template<class T, class... Options>
+    Tree<T, Options...> Intersection(
+        Tree<T, Options...> const& lhs, Tree<T, Options...> const& rhs,
+        Execution execution = Execution::Sequential
+    ) {
+      return Detail::Intersecting(lhs, rhs, Detail::ForkLevels(execution));
+    }
+
+
+  // The values of lhs that rhs does not have.
+  template<class T, class... Options>
+    Tree<T, Options...> Difference(
+        Tree<T, Options...> const& lhs, Tree<T, Options...> const& rhs,
+        Execution execution = Execution::Sequential
+    ) {
+      return Detail::Subtracting(lhs, rhs, Detail::ForkLevels(execution));
+    }
+} // Generics
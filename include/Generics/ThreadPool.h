@@ -0,0 +1,270 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Generics {
+  // Fork-join pool of worker threads. Every worker keeps a deque of the jobs
+  // it forked, working on the newest itself while idle workers steal the
+  // oldest, which are the biggest in a divide-and-conquer algorithm. A
+  // worker waiting for a stolen job runs other jobs meanwhile, so no thread
+  // ever blocks on one of its own subproblems.
+  class ThreadPool {
+    struct Job {
+      std::atomic<bool> done{false};
+      // Whether a thread outside the pool waits for it in run().
+      bool awaited{false};
+
+      virtual void execute() noexcept = 0;
+
+    protected:
+      ~Job() = default;
+    };
+
+    template<class Task>
+      struct JobOf final : Job {
+        Task& task;
+        std::optional<decltype(task())> result;
+        std::exception_ptr error;
+
+        explicit JobOf(Task& t) : task{t} {}
+
+        void execute() noexcept override {
+          try {
+            result.emplace(task());
+          }
+          catch (...) {
+            error = std::current_exception();
+          }
+          this->done.store(true, std::memory_order_release);
+        }
+
+        decltype(task()) take() {
+          if (error) {
+            std::rethrow_exception(error);
+          }
+          return std::move(*result);
+        }
+      };
+
+    struct Worker {
+      std::mutex mutex;
+      std::deque<Job*> jobs;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    // Jobs queued anywhere; idle workers sleep while there are none.
+    std::atomic<std::size_t> queued_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_{false};
+
+    // Jobs handed in from threads outside the pool, and their completion.
+    std::mutex injected_mutex_;
+    std::deque<Job*> injected_;
+    std::mutex finished_mutex_;
+    std::condition_variable finished_;
+
+    static inline thread_local ThreadPool* current_pool_{nullptr};
+    static inline thread_local std::size_t current_index_{0};
+
+    // Counts a job in before it is published, so that taking it never
+    // brings queued_ below zero.
+    void queuing() {
+      queued_.fetch_add(1, std::memory_order_release);
+    }
+
+    void wake_one() {
+      std::lock_guard<std::mutex> lock{sleep_mutex_};
+      wake_.notify_one();
+    }
+
+    Job* taken(std::deque<Job*>& jobs, bool newest) {
+      if (jobs.empty()) {
+        return nullptr;
+      }
+      auto* job = newest ? jobs.back() : jobs.front();
+      newest ? jobs.pop_back() : jobs.pop_front();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return job;
+    }
+
+    // The newest job of this worker, else the oldest of another one or
+    // handed in.
+    Job* next_job(std::size_t index) {
+      {
+        std::lock_guard<std::mutex> lock{workers_[index]->mutex};
+        if (auto* job = taken(workers_[index]->jobs, true)) {
+          return job;
+        }
+      }
+      for (std::size_t i = 1; i < workers_.size(); ++i) {
+        auto& victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock{victim.mutex};
+        if (auto* job = taken(victim.jobs, false)) {
+          return job;
+        }
+      }
+      std::lock_guard<std::mutex> lock{injected_mutex_};
+      return taken(injected_, false);
+    }
+
+    // Runs job, and wakes the threads waiting in run() when it is one of
+    // theirs. The job is gone once it is done, so it is asked first.
+    void execute(Job* job) {
+      const auto awaited = job->awaited;
+      job->execute();
+      if (awaited) {
+        std::lock_guard<std::mutex> lock{finished_mutex_};
+        finished_.notify_all();
+      }
+    }
+
+    void work(std::size_t index) {
+      current_pool_ = this;
+      current_index_ = index;
+      for (;;) {
+        if (auto* job = next_job(index)) {
+          execute(job);
+          continue;
+        }
+        std::unique_lock<std::mutex> lock{sleep_mutex_};
+        wake_.wait(lock, [this]() {
+          return stopping_ || queued_.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping_) {
+          return;
+        }
+      }
+    }
+
+    // Runs other jobs until job is done.
+    void help_until_done(Job const& job) {
+      while (!job.done.load(std::memory_order_acquire)) {
+        if (auto* other = next_job(current_index_)) {
+          execute(other);
+        }
+        else {
+          std::this_thread::yield();
+        }
+      }
+    }
+
+    // Takes job back when no other worker has stolen it yet.
+    bool reclaimed(Job* job) {
+      auto& worker = *workers_[current_index_];
+      std::lock_guard<std::mutex> lock{worker.mutex};
+      if (!worker.jobs.empty() && worker.jobs.back() == job) {
+        worker.jobs.pop_back();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+      return false;
+    }
+
+  public:
+    explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency()) {
+      threads = threads == 0 ? 1 : threads;
+      for (std::size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+      }
+      for (std::size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, i]() { work(i); });
+      }
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock{sleep_mutex_};
+        stopping_ = true;
+      }
+      wake_.notify_all();
+      for (auto& thread : threads_) {
+        thread.join();
+      }
+    }
+
+    std::size_t size() const noexcept { return workers_.size(); }
+
+    // A pool with a thread for every hardware thread.
+    static ThreadPool& Shared() {
+      static ThreadPool pool;
+      return pool;
+    }
+
+    // Runs task on the pool and returns what it returns, rethrowing what it
+    // throws. Tasks return a value.
+    template<class Task>
+      auto run(Task task) {
+        if (current_pool_ == this) {
+          return task();
+        }
+        JobOf<Task> job{task};
+        job.awaited = true;
+        queuing();
+        {
+          std::lock_guard<std::mutex> lock{injected_mutex_};
+          injected_.push_back(&job);
+        }
+        wake_one();
+        std::unique_lock<std::mutex> lock{finished_mutex_};
+        finished_.wait(lock, [&job]() { return job.done.load(std::memory_order_acquire); });
+        return job.take();
+      }
+
+    // Runs left and right, in parallel when a thread is free to, and returns
+    // both results. Off the pool's threads it runs as one task on the pool.
+    template<class Left, class Right>
+      auto both(Left left, Right right)
+          -> std::pair<std::invoke_result_t<Left&>, std::invoke_result_t<Right&>> {
+        if (current_pool_ != this) {
+          return run([&]() { return both(left, right); });
+        }
+
+        JobOf<Left> job{left};
+        queuing();
+        {
+          auto& worker = *workers_[current_index_];
+          std::lock_guard<std::mutex> lock{worker.mutex};
+          worker.jobs.push_back(&job);
+        }
+        wake_one();
+
+        std::optional<std::invoke_result_t<Right&>> right_result;
+        std::exception_ptr right_error;
+        try {
+          right_result.emplace(right());
+        }
+        catch (...) {
+          right_error = std::current_exception();
+        }
+
+        if (reclaimed(&job)) {
+          job.execute();
+        }
+        else {
+          help_until_done(job);
+        }
+        if (right_error) {
+          std::rethrow_exception(right_error);
+        }
+        auto left_result = job.take();
+        return {std::move(left_result), std::move(*right_result)};
+      }
+  };
+} // Generics
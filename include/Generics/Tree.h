@@ -1,233 +1,952 @@
 #pragma once
 
+#include "Generics/IntrusivePtr.h"
+#include "Generics/NodePool.h"
 #include <algorithm>
-#include <iostream>
+#include <initializer_list>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iterator>
-#include <memory>
-#include <numeric>
-#include <stack>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace Generics {
-  template<class T>
-    using SharedPtr = std::shared_ptr<T>;
+  enum class Colour : std::uint8_t {
+    Red, Black
+  };
 
 
-  template<class T>
+  // A measure is a monoid over the values of a tree that every node caches
+  // for its subtree: its Type, the Identity, the measure Of a single value
+  // and an associative Combined, which need not be commutative. Summing the
+  // lengths of pieces lets a tree find the piece at an offset, for one.
+  // Trees cache their size and height whatever the measure.
+  struct NoMeasure {
+    struct Type {};
+
+    static Type Identity() noexcept { return {}; }
+
+    template<class T>
+      static Type Of(T const&) noexcept { return {}; }
+
+    static Type Combined(Type, Type) noexcept { return {}; }
+  };
+
+
+  namespace Detail {
+    // What lookups compare the values of a tree with: the key itself when
+    // Compare is transparent, like std::less<>, or else a value made of it.
+    template<class Compare, class T, class Key, class = void>
+      struct LookupKey {
+        using Type = T;
+      };
+
+    template<class Compare, class T, class Key>
+      struct LookupKey<Compare, T, Key, std::void_t<typename Compare::is_transparent>> {
+        using Type = Key;
+      };
+  } // Detail
+
+
+  template<class T, class Compare, class RefCounting, class Measure>
+    class TreeBuilder;
+
+
+  // Persistent red-black tree: every operation returns a new version sharing
+  // all the subtrees it did not touch with the old one. No path from the root
+  // to a leaf is more than twice as long as another, so lookup, insertion and
+  // removal all take O(log n) time and recursion depth.
+  //
+  // Nodes count their references themselves and come from a NodePool, so
+  // copying a path costs no call to malloc. Trees that never cross threads
+  // can take LocalRefCount and skip the atomic operations.
+  //
+  // Values are ordered by a default constructed Compare: a comparator with
+  // state would have to be stored with every subtree. Lookups take any key
+  // a transparent Compare takes, and neither copy values nor touch a
+  // reference count.
+  //
+  // Every node caches the size, height and Measure of its subtree, so a tree
+  // answers Size and HeightOf in O(1) and Rank, Select and the measure of a
+  // range of values in O(log n).
+  template<
+      class T, class Compare = std::less<T>, class RefCounting = AtomicRefCount,
+      class Measure = NoMeasure
+  >
     class Tree {
     public:
+      using value_type = T;
+      using key_compare = Compare;
+      using ref_counting = RefCounting;
+      using measure_type = Measure;
+
       struct Node;
-      using NodePtr = SharedPtr<const Node>;
-      struct Node {
-        NodePtr left;
-        T value;
-        NodePtr right;
-
-        Node(NodePtr lhs, T v, NodePtr rhs) noexcept
-        : left{lhs}
-        , value{v}
-        , right{rhs} {}
-      };
+      using NodePtr = IntrusivePtr<const Node>;
+    private:
       NodePtr root_;
 
-    public:
-      Tree() = default;
-      Tree(Tree const& lhs, T value, Tree const& rhs) noexcept
-      : root_{std::make_shared<const Node>(lhs.root_, value, rhs.root_)} {}
-      explicit Tree(NodePtr root) noexcept : root_{root} {}
+      Node const* get() const noexcept { return root_.get(); }
 
+      friend class TreeBuilder<T, Compare, RefCounting, Measure>;
 
-      Tree(std::initializer_list<T> init_list) {
-        Tree result;
-        for (auto elem : init_list) {
-          result = Inserted(result, elem);
+      // A tree of count sorted, distinct values, each level of which is full
+      // but maybe the deepest: black down to the full ones, red below them.
+      static Tree Built(T* values, std::size_t count, std::size_t depth, std::size_t black_levels) {
+        if (count == 0) {
+          return {};
         }
-        root_ = result.root_;
+        const auto middle = count / 2;
+        auto lhs = Built(values, middle, depth + 1, black_levels);
+        auto rhs = Built(values + middle + 1, count - middle - 1, depth + 1, black_levels);
+        return Tree{Node::Make(
+            depth > black_levels ? Colour::Red : Colour::Black,
+            std::move(lhs), std::move(values[middle]), std::move(rhs)
+        )};
       }
 
+    public:
+      Tree() = default;
+      Tree(Colour colour, Tree const& lhs, T value, Tree const& rhs)
+      : root_{Node::Make(colour, lhs, std::move(value), rhs)} {}
+      explicit Tree(NodePtr root) noexcept : root_{std::move(root)} {}
+
+
+      Tree(std::initializer_list<T> init_list)
+      : Tree(init_list.begin(), init_list.end()) {}
+
+      // Keeps the first of equal values, as inserting them one by one would.
+      // Sorted values build the tree in O(n), others take a sort first.
       template<class InputIterator>
         Tree(InputIterator begin, InputIterator end) {
-          Tree from_sequence;
-          std::for_each(begin, end,
-              [&from_sequence](T elem) {
-                from_sequence = Inserted(from_sequence, elem);
-              }
+          std::vector<T> values(begin, end);
+          if (!std::is_sorted(values.begin(), values.end(), Compare{})) {
+            std::stable_sort(values.begin(), values.end(), Compare{});
+          }
+          values.erase(
+              std::unique(values.begin(), values.end(),
+                  [](T const& lhs, T const& rhs) { return !Compare{}(lhs, rhs); }
+              ),
+              values.end()
           );
-          root_ = from_sequence.root_;
+
+          std::size_t black_levels{0};
+          while ((std::size_t{2} << black_levels) <= values.size() + 1) {
+            ++black_levels;
+          }
+          *this = Built(values.data(), values.size(), 1, black_levels);
         }
 
       bool empty() const noexcept { return !root_; }
-      T root() const noexcept { return root_->value; }
-      Tree left() const noexcept { return Tree{root_->left}; }
-      Tree right() const noexcept { return Tree{root_->right}; }
+      T const& root() const noexcept { return root_->value; }
+      Tree const& left() const noexcept { return root_->left; }
+      Tree const& right() const noexcept { return root_->right; }
+      Colour colour() const noexcept { return root_->colour; }
+      std::size_t black_height() const noexcept { return root_ ? root_->black_height : 0; }
+      std::size_t size() const noexcept { return root_ ? root_->size : 0; }
+      std::size_t height() const noexcept { return root_ ? root_->height : 0; }
+      typename Measure::Type measure() const { return root_ ? root_->measure : Measure::Identity(); }
+      NodePtr const& node() const noexcept { return root_; }
+
+      // The deepest path a red-black tree of up to 2^48 elements can have.
+      static constexpr std::size_t MaxHeight{96};
 
-      class Iterator
-      : public std::iterator<std::output_iterator_tag, T> {
-        NodePtr current_{nullptr};
-        std::stack<NodePtr> path_;
+      // In-order iterator over the values. It keeps the path from the root down
+      // to the current node inline as raw pointers, so neither stepping nor
+      // copying allocates or touches a reference count; like the iterators of
+      // standard containers it is valid as long as the tree it came from (or
+      // another version sharing its nodes) is alive.
+      class Iterator {
+        Node const* root_{nullptr};
+        Node const* path_[MaxHeight];
+        std::size_t depth_{0};
 
-        Iterator(Tree const& tree) {
-          current_ = tree.root_;
-          while (current_->left) {
-            path_.push(current_);
-            current_ = current_->left;
+        explicit Iterator(Node const* root) noexcept : root_{root} {}
+
+        void descend_left(Node const* node) noexcept {
+          for (; node; node = node->left.get()) {
+            path_[depth_++] = node;
           }
         }
 
-        Iterator() = default;
+        void descend_right(Node const* node) noexcept {
+          for (; node; node = node->right.get()) {
+            path_[depth_++] = node;
+          }
+        }
+
+        // Pops the path up to the first ancestor reached from its child on
+        // the given side, or empties it.
+        template<class Side>
+          void ascend(Side side) noexcept {
+            while (depth_ > 1 && side(path_[depth_ - 2]) == path_[depth_ - 1]) {
+              --depth_;
+            }
+            --depth_;
+          }
 
         friend class Tree;
 
       public:
-        Iterator(Iterator const& other)
-        : current_{other.current_}
-        , path_{other.path_} {}
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T const*;
+        using reference = T const&;
+
+        Iterator() noexcept = default;
+
+        Iterator(Iterator const& other) noexcept
+        : root_{other.root_}
+        , depth_{other.depth_} {
+          std::copy_n(other.path_, depth_, path_);
+        }
 
-        T const& operator*() const {
-          return current_->value;
+        Iterator& operator=(Iterator const& other) noexcept {
+          root_ = other.root_;
+          depth_ = other.depth_;
+          std::copy_n(other.path_, depth_, path_);
+          return *this;
         }
 
-        T const* operator->() const {
-          return current_.get();
+        T const& operator*() const noexcept {
+          return path_[depth_ - 1]->value;
         }
 
-        Iterator& operator++() {
-          if (!current_) {
-            return *this;
+        T const* operator->() const noexcept {
+          return &path_[depth_ - 1]->value;
+        }
+
+        Iterator& operator++() noexcept {
+          auto const* right = path_[depth_ - 1]->right.get();
+          if (right) {
+            path_[depth_++] = right;
+            descend_left(right->left.get());
           }
-          else if (path_.empty()) {
-            current_.reset();
-            return *this;
+          else {
+            ascend([](Node const* node) { return node->right.get(); });
           }
-          else if (current_ == path_.top()->left) {
-            current_ = path_.top();
-            return *this;
+          return *this;
+        }
+
+        Iterator operator++(int) noexcept {
+          Iterator result = *this;
+          ++*this;
+          return result;
+        }
+
+        // Stepping back from the end reaches the last value.
+        Iterator& operator--() noexcept {
+          if (depth_ == 0) {
+            descend_right(root_);
           }
-          else if (current_ == path_.top() && current_->right) {
-            current_ = current_->right;
-            while (current_->left) {
-              current_ = current_->left;
-            }
-            return *this;
+          else if (auto const* left = path_[depth_ - 1]->left.get()) {
+            path_[depth_++] = left;
+            descend_right(left->right.get());
           }
           else {
-            path_.pop();
-            current_ = path_.empty() ? NodePtr{} : path_.top();
-            return *this;
+            ascend([](Node const* node) { return node->left.get(); });
           }
+          return *this;
         }
 
-        Iterator operator++(int) const {
+        Iterator operator--(int) noexcept {
           Iterator result = *this;
-          result++;
+          --*this;
           return result;
         }
 
-        Iterator& operator=(Iterator const& rhs) = default;
-        bool operator==(Iterator const& rhs) const {
-          return current_ == rhs.current_;
+        bool operator==(Iterator const& rhs) const noexcept {
+          return (depth_ == 0 ? nullptr : path_[depth_ - 1])
+              == (rhs.depth_ == 0 ? nullptr : rhs.path_[rhs.depth_ - 1]);
         }
-        bool operator!=(Iterator const& rhs) const {
-          return current_ != rhs.current_;
+        bool operator!=(Iterator const& rhs) const noexcept {
+          return !(*this == rhs);
         }
       };
 
-      Iterator begin() const { return Iterator{*this}; }
-      Iterator end() const { return Iterator{}; }
+      using iterator = Iterator;
+      using const_iterator = Iterator;
+      using ReverseIterator = std::reverse_iterator<Iterator>;
+      using reverse_iterator = ReverseIterator;
+      using const_reverse_iterator = ReverseIterator;
+
+      Iterator begin() const noexcept {
+        Iterator result{root_.get()};
+        result.descend_left(root_.get());
+        return result;
+      }
+      Iterator end() const noexcept { return Iterator{root_.get()}; }
+      ReverseIterator rbegin() const noexcept { return ReverseIterator{end()}; }
+      ReverseIterator rend() const noexcept { return ReverseIterator{begin()}; }
+
+      // The first value not less than key, in O(log n).
+      template<class Key>
+        Iterator lower_bound(Key const& key) const {
+          typename Detail::LookupKey<Compare, T, Key>::Type const& lookup = key;
+          return bound([&lookup](T const& value) { return !Compare{}(value, lookup); });
+        }
+
+      // The first value greater than key, in O(log n).
+      template<class Key>
+        Iterator upper_bound(Key const& key) const {
+          typename Detail::LookupKey<Compare, T, Key>::Type const& lookup = key;
+          return bound([&lookup](T const& value) { return Compare{}(lookup, value); });
+        }
+
+    private:
+      // The first value satisfying goes_left, which holds for a suffix of the
+      // values. The path down to it is part of the path searched.
+      template<class GoesLeft>
+        Iterator bound(GoesLeft goes_left) const noexcept {
+          Iterator result{root_.get()};
+          std::size_t found_depth{0};
+          for (auto const* node = root_.get(); node;) {
+            result.path_[result.depth_++] = node;
+            if (goes_left(node->value)) {
+              found_depth = result.depth_;
+              node = node->left.get();
+            }
+            else {
+              node = node->right.get();
+            }
+          }
+          result.depth_ = found_depth;
+          return result;
+        }
+
+    public:
       bool operator==(Tree const& rhs) const { return root_ == rhs.root_; }
       bool operator!=(Tree const& rhs) const { return root_ != rhs.root_; }
     };
 
 
-  template<class T>
-    Tree<T> Inserted(Tree<T> const& tree, T value) {
-      using TreeType = Tree<T>;
-      if (tree.empty()) {
-        return Tree{TreeType{}, value, TreeType{}};
+  // Holding the subtrees as trees lets left() and right() hand out
+  // references instead of new trees.
+  template<class T, class Compare, class RefCounting, class Measure>
+    struct Tree<T, Compare, RefCounting, Measure>::Node {
+      mutable typename RefCounting::Counter references{1};
+      Colour colour;
+      // Black nodes on every path from this one down to a leaf, itself
+      // included, which lets two trees be joined without walking them.
+      std::uint8_t black_height{0};
+      std::uint8_t height{0};
+      typename Measure::Type measure;
+      std::size_t size{0};
+      Tree left;
+      T value;
+      Tree right;
+
+      Node(Colour c, Tree lhs, T v, Tree rhs)
+      : colour{c}
+      , measure{Measure::Identity()}
+      , left{std::move(lhs)}
+      , value{std::move(v)}
+      , right{std::move(rhs)} {
+        recount();
       }
-      else {
-        T root{tree.root()};
-        if (value < root) {
-          return Tree{Inserted(tree.left(), value), root, tree.right()};
+
+      // Derives what the node caches from its colour and subtrees again.
+      void recount() {
+        black_height = static_cast<std::uint8_t>(
+            left.black_height() + (colour == Colour::Black ? 1 : 0)
+        );
+        height = static_cast<std::uint8_t>(std::max(left.height(), right.height()) + 1);
+        size = left.size() + 1 + right.size();
+        measure = Measure::Combined(
+            Measure::Combined(left.measure(), Measure::Of(value)), right.measure()
+        );
+      }
+
+      static NodePtr Make(Colour c, Tree lhs, T v, Tree rhs) {
+        return NodePtr::Adopt(new (NodePool<Node>::Allocate()) Node{
+            c, std::move(lhs), std::move(v), std::move(rhs)
+        });
+      }
+
+      friend void Retain(Node const* node) noexcept {
+        RefCounting::Increment(node->references);
+      }
+
+      friend void Release(Node const* node) noexcept {
+        if (RefCounting::Decrement(node->references)) {
+          auto* mutable_node = const_cast<Node*>(node);
+          mutable_node->~Node();
+          NodePool<Node>::Deallocate(mutable_node);
         }
-        else if (root < value) {
-          return Tree{tree.left(), root, Inserted(tree.right(), value)};
+      }
+    };
+
+
+  // The rebalancing steps of Kahrs' "Red-black trees with types" (JFP 2001),
+  // persistent insertion and deletion that only ever rebuild the nodes on the
+  // path they walk down.
+  namespace Detail {
+    template<class TreeType, class Lhs, class Rhs>
+      bool Less(Lhs const& lhs, Rhs const& rhs) {
+        return typename TreeType::key_compare{}(lhs, rhs);
+      }
+
+
+    template<class TreeType>
+      bool IsRed(TreeType const& tree) {
+        return !tree.empty() && tree.colour() == Colour::Red;
+      }
+
+
+    template<class TreeType>
+      TreeType Blackened(TreeType const& tree) {
+        if (tree.empty() || tree.colour() == Colour::Black) {
+          return tree;
         }
         else {
-          return tree;
+          return TreeType{Colour::Black, tree.left(), tree.root(), tree.right()};
         }
       }
-    }
 
-  template<class T>
-    Tree<T> Removed(Tree<T> const& tree, T value) {
-      using TreeType = Tree<T>;
-      if (tree.empty()) {
-        return tree;
+
+    // Precondition: tree is a black node.
+    template<class TreeType>
+      TreeType Reddened(TreeType const& tree) {
+        return TreeType{Colour::Red, tree.left(), tree.root(), tree.right()};
       }
-      else {
-        const T root{tree.root()};
-        if (value < root) {
-          const auto left = Removed(tree.left(), value);
-          if (left != tree.left()) {
-            return Tree{Removed(tree.left(), value), root, tree.right()};
+
+
+    // A black node over lhs and rhs, or a red node with black children when one
+    // side holds two reds in a row.
+    template<class TreeType>
+      TreeType Balanced(
+          TreeType const& lhs, typename TreeType::value_type const& value, TreeType const& rhs
+      ) {
+        if (IsRed(lhs) && IsRed(rhs)) {
+          return TreeType{Colour::Red, Blackened(lhs), value, Blackened(rhs)};
+        }
+        else if (IsRed(lhs) && IsRed(lhs.left())) {
+          return TreeType{
+              Colour::Red,
+              Blackened(lhs.left()),
+              lhs.root(),
+              TreeType{Colour::Black, lhs.right(), value, rhs}
+          };
+        }
+        else if (IsRed(lhs) && IsRed(lhs.right())) {
+          auto const& middle = lhs.right();
+          return TreeType{
+              Colour::Red,
+              TreeType{Colour::Black, lhs.left(), lhs.root(), middle.left()},
+              middle.root(),
+              TreeType{Colour::Black, middle.right(), value, rhs}
+          };
+        }
+        else if (IsRed(rhs) && IsRed(rhs.right())) {
+          return TreeType{
+              Colour::Red,
+              TreeType{Colour::Black, lhs, value, rhs.left()},
+              rhs.root(),
+              Blackened(rhs.right())
+          };
+        }
+        else if (IsRed(rhs) && IsRed(rhs.left())) {
+          auto const& middle = rhs.left();
+          return TreeType{
+              Colour::Red,
+              TreeType{Colour::Black, lhs, value, middle.left()},
+              middle.root(),
+              TreeType{Colour::Black, middle.right(), rhs.root(), rhs.right()}
+          };
+        }
+        else {
+          return TreeType{Colour::Black, lhs, value, rhs};
+        }
+      }
+
+
+    // Precondition: lhs is one black level lower than rhs.
+    template<class TreeType>
+      TreeType BalancedLeft(
+          TreeType const& lhs, typename TreeType::value_type const& value, TreeType const& rhs
+      ) {
+        if (IsRed(lhs)) {
+          return TreeType{Colour::Red, Blackened(lhs), value, rhs};
+        }
+        else if (!IsRed(rhs)) {
+          return Balanced(lhs, value, Reddened(rhs));
+        }
+        else {
+          auto const& middle = rhs.left();
+          return TreeType{
+              Colour::Red,
+              TreeType{Colour::Black, lhs, value, middle.left()},
+              middle.root(),
+              Balanced(middle.right(), rhs.root(), Reddened(rhs.right()))
+          };
+        }
+      }
+
+
+    // Precondition: rhs is one black level lower than lhs.
+    template<class TreeType>
+      TreeType BalancedRight(
+          TreeType const& lhs, typename TreeType::value_type const& value, TreeType const& rhs
+      ) {
+        if (IsRed(rhs)) {
+          return TreeType{Colour::Red, lhs, value, Blackened(rhs)};
+        }
+        else if (!IsRed(lhs)) {
+          return Balanced(Reddened(lhs), value, rhs);
+        }
+        else {
+          auto const& middle = lhs.right();
+          return TreeType{
+              Colour::Red,
+              Balanced(Reddened(lhs.left()), lhs.root(), middle.left()),
+              middle.root(),
+              TreeType{Colour::Black, middle.right(), value, rhs}
+          };
+        }
+      }
+
+
+    // All of lhs followed by all of rhs, both of the same black height.
+    template<class TreeType>
+      TreeType Appended(TreeType const& lhs, TreeType const& rhs) {
+        if (lhs.empty()) {
+          return rhs;
+        }
+        else if (rhs.empty()) {
+          return lhs;
+        }
+        else if (IsRed(lhs) && IsRed(rhs)) {
+          const auto middle = Appended(lhs.right(), rhs.left());
+          if (IsRed(middle)) {
+            return TreeType{
+                Colour::Red,
+                TreeType{Colour::Red, lhs.left(), lhs.root(), middle.left()},
+                middle.root(),
+                TreeType{Colour::Red, middle.right(), rhs.root(), rhs.right()}
+            };
           }
           else {
-            return tree;
+            return TreeType{
+                Colour::Red,
+                lhs.left(),
+                lhs.root(),
+                TreeType{Colour::Red, middle, rhs.root(), rhs.right()}
+            };
+          }
+        }
+        else if (!IsRed(lhs) && !IsRed(rhs)) {
+          const auto middle = Appended(lhs.right(), rhs.left());
+          if (IsRed(middle)) {
+            return TreeType{
+                Colour::Red,
+                TreeType{Colour::Black, lhs.left(), lhs.root(), middle.left()},
+                middle.root(),
+                TreeType{Colour::Black, middle.right(), rhs.root(), rhs.right()}
+            };
           }
+          else {
+            return BalancedLeft(
+                lhs.left(),
+                lhs.root(),
+                TreeType{Colour::Black, middle, rhs.root(), rhs.right()}
+            );
+          }
+        }
+        else if (IsRed(rhs)) {
+          return TreeType{Colour::Red, Appended(lhs, rhs.left()), rhs.root(), rhs.right()};
         }
-        else if (root < value) {
-          const auto right = Removed(tree.right(), value);
-          if (right != tree.right()) {
-            return Tree{tree.left(), root, Removed(tree.right(), value)};
+        else {
+          return TreeType{Colour::Red, lhs.left(), lhs.root(), Appended(lhs.right(), rhs)};
+        }
+      }
+
+
+    // The tree with value added, possibly with a red root over a red child.
+    // An equal value already there is kept, returning the same tree, unless
+    // replacing.
+    template<class TreeType>
+      TreeType Inserting(
+          TreeType const& tree, typename TreeType::value_type const& value, bool replacing
+      ) {
+        if (tree.empty()) {
+          return TreeType{Colour::Red, TreeType{}, value, TreeType{}};
+        }
+
+        auto const& root = tree.root();
+        if (Less<TreeType>(value, root)) {
+          const auto left = Inserting(tree.left(), value, replacing);
+          if (left == tree.left()) {
+            return tree;
+          }
+          else if (tree.colour() == Colour::Black) {
+            return Balanced(left, root, tree.right());
           }
           else {
+            return TreeType{Colour::Red, left, root, tree.right()};
+          }
+        }
+        else if (Less<TreeType>(root, value)) {
+          const auto right = Inserting(tree.right(), value, replacing);
+          if (right == tree.right()) {
             return tree;
           }
+          else if (tree.colour() == Colour::Black) {
+            return Balanced(tree.left(), root, right);
+          }
+          else {
+            return TreeType{Colour::Red, tree.left(), root, right};
+          }
+        }
+        else if (replacing) {
+          return TreeType{tree.colour(), tree.left(), value, tree.right()};
         }
         else {
-          if (!tree.left().empty()) {
-            return Tree{tree.left().left(), tree.left().root(), tree.right()};
+          return tree;
+        }
+      }
+
+
+    // Precondition: key is in the tree. When the root of tree was black the
+    // result is one black level lower.
+    template<class TreeType, class Key>
+      TreeType Removing(TreeType const& tree, Key const& key) {
+        auto const& root = tree.root();
+        if (Less<TreeType>(key, root)) {
+          if (IsRed(tree.left())) {
+            return TreeType{Colour::Red, Removing(tree.left(), key), root, tree.right()};
+          }
+          else {
+            return BalancedLeft(Removing(tree.left(), key), root, tree.right());
           }
-          else if (!tree.right().empty()) {
-            return TreeType{TreeType{}, tree.right().root(), tree.right().right()};
+        }
+        else if (Less<TreeType>(root, key)) {
+          if (IsRed(tree.right())) {
+            return TreeType{Colour::Red, tree.left(), root, Removing(tree.right(), key)};
           }
           else {
-            return {};
+            return BalancedRight(tree.left(), root, Removing(tree.right(), key));
           }
         }
+        else {
+          return Appended(tree.left(), tree.right());
+        }
+      }
+
+
+    // Joining two trees of different black heights after Blelloch, Ferizovic
+    // and Sun, "Just Join for Parallel Ordered Sets" (SPAA 2016): walk down
+    // the spine of the taller tree to a black node as high as the other tree
+    // and hang both under a red node there, fixing two reds in a row with a
+    // rotation on the way back up. Precondition: rhs is black and not higher
+    // than lhs.
+    template<class TreeType>
+      TreeType JoinedRight(
+          TreeType const& lhs, typename TreeType::value_type const& value, TreeType const& rhs
+      ) {
+        if (!IsRed(lhs) && lhs.black_height() == rhs.black_height()) {
+          return TreeType{Colour::Red, lhs, value, rhs};
+        }
+        const auto right = JoinedRight(lhs.right(), value, rhs);
+        if (!IsRed(lhs) && IsRed(right) && IsRed(right.right())) {
+          return TreeType{
+              Colour::Red,
+              TreeType{Colour::Black, lhs.left(), lhs.root(), right.left()},
+              right.root(),
+              Blackened(right.right())
+          };
+        }
+        return TreeType{lhs.colour(), lhs.left(), lhs.root(), right};
       }
+
+
+    // The mirror image of JoinedRight.
+    template<class TreeType>
+      TreeType JoinedLeft(
+          TreeType const& lhs, typename TreeType::value_type const& value, TreeType const& rhs
+      ) {
+        if (!IsRed(rhs) && rhs.black_height() == lhs.black_height()) {
+          return TreeType{Colour::Red, lhs, value, rhs};
+        }
+        const auto left = JoinedLeft(lhs, value, rhs.left());
+        if (!IsRed(rhs) && IsRed(left) && IsRed(left.left())) {
+          return TreeType{
+              Colour::Red,
+              Blackened(left.left()),
+              left.root(),
+              TreeType{Colour::Black, left.right(), rhs.root(), rhs.right()}
+          };
+        }
+        return TreeType{rhs.colour(), left, rhs.root(), rhs.right()};
+      }
+  } // Detail
+
+
+  // The value equal to key, or nullptr.
+  template<class T, class... Options, class Key>
+    T const* Find(Tree<T, Options...> const& tree, Key const& key) {
+      using TreeType = Tree<T, Options...>;
+      typename Detail::LookupKey<typename TreeType::key_compare, T, Key>::Type const& lookup = key;
+      for (auto const* subtree = &tree; !subtree->empty();) {
+        auto const& value = subtree->root();
+        if (Detail::Less<TreeType>(lookup, value)) {
+          subtree = &subtree->left();
+        }
+        else if (Detail::Less<TreeType>(value, lookup)) {
+          subtree = &subtree->right();
+        }
+        else {
+          return &value;
+        }
+      }
+      return nullptr;
     }
 
 
-  template<class T>
-    bool Has(Tree<T> const& tree, T value) {
-      if (tree.empty()) {
-        return false;
+  template<class T, class... Options, class Key>
+    bool Has(Tree<T, Options...> const& tree, Key const& key) {
+      return Find(tree, key) != nullptr;
+    }
+
+
+  // Returns the same tree when an equal value is already there.
+  template<class T, class... Options>
+    Tree<T, Options...> Inserted(Tree<T, Options...> const& tree, T value) {
+      return Detail::Blackened(Detail::Inserting(tree, value, false));
+    }
+
+
+  // The tree with value in place of an equal one, or added.
+  template<class T, class... Options>
+    Tree<T, Options...> Assigned(Tree<T, Options...> const& tree, T value) {
+      return Detail::Blackened(Detail::Inserting(tree, value, true));
+    }
+
+
+  // Returns the same tree when no value equals key.
+  template<class T, class... Options, class Key>
+    Tree<T, Options...> Removed(Tree<T, Options...> const& tree, Key const& key) {
+      using TreeType = Tree<T, Options...>;
+      typename Detail::LookupKey<typename TreeType::key_compare, T, Key>::Type const& lookup = key;
+      if (!Has(tree, lookup)) {
+        return tree;
       }
       else {
-        T root{tree.root()};
-        if (value < root) {
-          return Has(tree.left(), value);
+        return Detail::Blackened(Detail::Removing(tree, lookup));
+      }
+    }
+
+
+  template<class T, class... Options>
+    std::size_t HeightOf(Tree<T, Options...> const& tree) {
+      return tree.height();
+    }
+
+
+  template<class T, class... Options>
+    std::size_t Size(Tree<T, Options...> const& tree) {
+      return tree.size();
+    }
+
+
+  // How many values are less than key.
+  template<class T, class... Options, class Key>
+    std::size_t Rank(Tree<T, Options...> const& tree, Key const& key) {
+      using TreeType = Tree<T, Options...>;
+      typename Detail::LookupKey<typename TreeType::key_compare, T, Key>::Type const& lookup = key;
+      std::size_t rank{0};
+      for (auto const* subtree = &tree; !subtree->empty();) {
+        if (Detail::Less<TreeType>(subtree->root(), lookup)) {
+          rank += subtree->left().size() + 1;
+          subtree = &subtree->right();
+        }
+        else {
+          subtree = &subtree->left();
+        }
+      }
+      return rank;
+    }
+
+
+  // The value at index in order, or nullptr past the end.
+  template<class T, class... Options>
+    T const* Select(Tree<T, Options...> const& tree, std::size_t index) {
+      for (auto const* subtree = &tree; !subtree->empty();) {
+        const auto left_size = subtree->left().size();
+        if (index < left_size) {
+          subtree = &subtree->left();
+        }
+        else if (index == left_size) {
+          return &subtree->root();
+        }
+        else {
+          index -= left_size + 1;
+          subtree = &subtree->right();
+        }
+      }
+      return nullptr;
+    }
+
+
+  // The measure of the values less than key.
+  template<class T, class... Options, class Key>
+    auto MeasureBefore(Tree<T, Options...> const& tree, Key const& key) {
+      using TreeType = Tree<T, Options...>;
+      using Measure = typename TreeType::measure_type;
+      typename Detail::LookupKey<typename TreeType::key_compare, T, Key>::Type const& lookup = key;
+      auto result = Measure::Identity();
+      for (auto const* subtree = &tree; !subtree->empty();) {
+        if (Detail::Less<TreeType>(subtree->root(), lookup)) {
+          result = Measure::Combined(
+              result,
+              Measure::Combined(subtree->left().measure(), Measure::Of(subtree->root()))
+          );
+          subtree = &subtree->right();
         }
-        else if (root < value) {
-          return Has(tree.right(), value);
+        else {
+          subtree = &subtree->left();
+        }
+      }
+      return result;
+    }
+
+
+  // The measure of the values not less than key.
+  template<class T, class... Options, class Key>
+    auto MeasureFrom(Tree<T, Options...> const& tree, Key const& key) {
+      using TreeType = Tree<T, Options...>;
+      using Measure = typename TreeType::measure_type;
+      typename Detail::LookupKey<typename TreeType::key_compare, T, Key>::Type const& lookup = key;
+      auto result = Measure::Identity();
+      for (auto const* subtree = &tree; !subtree->empty();) {
+        if (Detail::Less<TreeType>(subtree->root(), lookup)) {
+          subtree = &subtree->right();
         }
         else {
-          return true;
+          result = Measure::Combined(
+              Measure::Combined(Measure::Of(subtree->root()), subtree->right().measure()),
+              result
+          );
+          subtree = &subtree->left();
         }
       }
+      return result;
     }
 
 
-  template<class T>
-    std::size_t HeightOf(Tree<T> const& tree) {
+  // The measure of the values not less than lower and less than upper: the
+  // node where the searches for the two part ways is in the range, and the
+  // rest of it hangs off the two paths below.
+  template<class T, class... Options, class Lower, class Upper>
+    auto MeasureBetween(Tree<T, Options...> const& tree, Lower const& lower, Upper const& upper) {
+      using TreeType = Tree<T, Options...>;
+      using Measure = typename TreeType::measure_type;
+      using Compare = typename TreeType::key_compare;
+      typename Detail::LookupKey<Compare, T, Lower>::Type const& from = lower;
+      typename Detail::LookupKey<Compare, T, Upper>::Type const& to = upper;
+      for (auto const* subtree = &tree; !subtree->empty();) {
+        if (Detail::Less<TreeType>(subtree->root(), from)) {
+          subtree = &subtree->right();
+        }
+        else if (!Detail::Less<TreeType>(subtree->root(), to)) {
+          subtree = &subtree->left();
+        }
+        else {
+          return Measure::Combined(
+              Measure::Combined(MeasureFrom(subtree->left(), from), Measure::Of(subtree->root())),
+              MeasureBefore(subtree->right(), to)
+          );
+        }
+      }
+      return Measure::Identity();
+    }
+
+
+  // The values of lhs, value, then the values of rhs, where all of lhs are
+  // less than value and all of rhs greater. Takes O(|black height of lhs -
+  // black height of rhs| + 1) time and rebuilds only the spine it walks.
+  template<class T, class... Options>
+    Tree<T, Options...> Joined(Tree<T, Options...> const& lhs, T value, Tree<T, Options...> const& rhs) {
+      const auto left = Detail::Blackened(lhs);
+      const auto right = Detail::Blackened(rhs);
+      if (left.black_height() > right.black_height()) {
+        const auto joined = Detail::JoinedRight(left, value, right);
+        return Detail::IsRed(joined) && Detail::IsRed(joined.right())
+            ? Detail::Blackened(joined)
+            : joined
+        ;
+      }
+      else if (right.black_height() > left.black_height()) {
+        const auto joined = Detail::JoinedLeft(left, value, right);
+        return Detail::IsRed(joined) && Detail::IsRed(joined.left())
+            ? Detail::Blackened(joined)
+            : joined
+        ;
+      }
+      else {
+        return Tree<T, Options...>{Colour::Red, left, std::move(value), right};
+      }
+    }
+
+
+  // Splits off the last value of a non-empty tree.
+  template<class T, class... Options>
+    std::pair<Tree<T, Options...>, T> SplitLast(Tree<T, Options...> const& tree) {
+      if (tree.right().empty()) {
+        return {tree.left(), tree.root()};
+      }
+      else {
+        auto [rest, last] = SplitLast(tree.right());
+        return {Joined(tree.left(), tree.root(), rest), std::move(last)};
+      }
+    }
+
+
+  // The values of lhs followed by the values of rhs, all of which have to be
+  // greater.
+  template<class T, class... Options>
+    Tree<T, Options...> Concatenated(Tree<T, Options...> const& lhs, Tree<T, Options...> const& rhs) {
+      if (lhs.empty()) {
+        return rhs;
+      }
+      else if (rhs.empty()) {
+        return lhs;
+      }
+      else {
+        auto [rest, last] = SplitLast(lhs);
+        return Joined(rest, std::move(last), rhs);
+      }
+    }
+
+
+  template<class TreeType>
+    struct Split {
+      TreeType less;
+      bool found;
+      TreeType greater;
+    };
+
+  // The values less and greater than value, in O(log n). A value found at a
+  // node leaves that node's subtrees untouched in the two parts.
+  template<class T, class... Options>
+    Split<Tree<T, Options...>> SplitAt(Tree<T, Options...> const& tree, T const& value) {
       if (tree.empty()) {
-        return 0;
+        return {{}, false, {}};
+      }
+      T root{tree.root()};
+      if (Detail::Less<Tree<T, Options...>>(value, root)) {
+        auto parts = SplitAt(tree.left(), value);
+        parts.greater = Joined(parts.greater, std::move(root), tree.right());
+        return parts;
+      }
+      else if (Detail::Less<Tree<T, Options...>>(root, value)) {
+        auto parts = SplitAt(tree.right(), value);
+        parts.less = Joined(tree.left(), std::move(root), parts.less);
+        return parts;
       }
       else {
-        const auto height_of_left = HeightOf(tree.left());
-        const auto height_of_right = HeightOf(tree.right());
-        return std::max(height_of_left, height_of_right) + 1;
+        return {tree.left(), true, tree.right()};
       }
     }
-} // Generics
\ No newline at end of file
+} // Generics
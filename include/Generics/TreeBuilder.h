@@ -0,0 +1,339 @@
+#pragma once
+
+#include "Generics/Tree.h"
+#include <functional>
+#include <utility>
+
+namespace Generics {
+  // A batch of insertions and removals on a Tree. Nodes nobody else refers to
+  // are changed in place instead of copied, so a tree loaded through a
+  // builder costs about what a mutable container would. Nodes shared with a
+  // Tree are copied on the way down like Inserted and Removed do, which keeps
+  // every Tree unchanged; taking tree() shares them all, so it takes O(1) and
+  // the builder can go on afterwards.
+  //
+  // Like any container, one builder is for one thread at a time.
+  template<
+      class T, class Compare = std::less<T>, class RefCounting = AtomicRefCount,
+      class Measure = NoMeasure
+  >
+    class TreeBuilder {
+    public:
+      using TreeType = Tree<T, Compare, RefCounting, Measure>;
+
+    private:
+      using Node = typename TreeType::Node;
+
+      TreeType root_;
+
+      static bool IsRed(TreeType const& tree) noexcept {
+        return !tree.empty() && tree.colour() == Colour::Red;
+      }
+
+      static bool Less(T const& lhs, T const& rhs) {
+        return Compare{}(lhs, rhs);
+      }
+
+      // The root of a tree known to be unshared.
+      static Node* Mutable(TreeType const& tree) noexcept {
+        return const_cast<Node*>(tree.get());
+      }
+
+      // Every node whose subtrees change is recounted after them, bottom up,
+      // to keep what it caches of them right.
+      static void Recounted(Node* node) {
+        node->recount();
+      }
+
+      static void Recoloured(Node* node, Colour colour) {
+        node->colour = colour;
+        Recounted(node);
+      }
+
+      // The node in slot for changing, copied first unless slot holds the
+      // only reference to it. Nodes are created non-const, which makes
+      // changing an unshared one safe.
+      static Node* Unique(TreeType& slot) {
+        if (!RefCounting::Unique(slot.get()->references)) {
+          slot = TreeType{slot.colour(), slot.left(), slot.root(), slot.right()};
+        }
+        return Mutable(slot);
+      }
+
+
+      // Okasaki's insertion: a black node with a red child and grandchild on
+      // the path just walked becomes a red node over two black ones.
+      static void BalancedLeft(TreeType& slot) {
+        auto* node = Mutable(slot);
+        if (node->colour != Colour::Black || !IsRed(node->left)) {
+          return;
+        }
+        auto* left = Unique(node->left);
+        if (IsRed(left->left)) {
+          TreeType top = std::move(node->left);
+          node->left = std::move(left->right);
+          Recounted(node);
+          left->right = std::move(slot);
+          Recoloured(Unique(left->left), Colour::Black);
+          Recoloured(left, Colour::Red);
+          slot = std::move(top);
+        }
+        else if (IsRed(left->right)) {
+          TreeType top = std::move(left->right);
+          auto* middle = Unique(top);
+          left->right = std::move(middle->left);
+          Recoloured(left, Colour::Black);
+          middle->left = std::move(node->left);
+          node->left = std::move(middle->right);
+          Recounted(node);
+          middle->right = std::move(slot);
+          Recoloured(middle, Colour::Red);
+          slot = std::move(top);
+        }
+      }
+
+      static void BalancedRight(TreeType& slot) {
+        auto* node = Mutable(slot);
+        if (node->colour != Colour::Black || !IsRed(node->right)) {
+          return;
+        }
+        auto* right = Unique(node->right);
+        if (IsRed(right->right)) {
+          TreeType top = std::move(node->right);
+          node->right = std::move(right->left);
+          Recounted(node);
+          right->left = std::move(slot);
+          Recoloured(Unique(right->right), Colour::Black);
+          Recoloured(right, Colour::Red);
+          slot = std::move(top);
+        }
+        else if (IsRed(right->left)) {
+          TreeType top = std::move(right->left);
+          auto* middle = Unique(top);
+          right->left = std::move(middle->right);
+          Recoloured(right, Colour::Black);
+          middle->right = std::move(node->right);
+          node->right = std::move(middle->left);
+          Recounted(node);
+          middle->left = std::move(slot);
+          Recoloured(middle, Colour::Red);
+          slot = std::move(top);
+        }
+      }
+
+      static void Inserting(TreeType& slot, T& value) {
+        if (slot.empty()) {
+          slot = TreeType{Colour::Red, {}, std::move(value), {}};
+          return;
+        }
+        auto* node = Unique(slot);
+        if (Less(value, node->value)) {
+          Inserting(node->left, value);
+          Recounted(node);
+          BalancedLeft(slot);
+        }
+        else if (Less(node->value, value)) {
+          Inserting(node->right, value);
+          Recounted(node);
+          BalancedRight(slot);
+        }
+      }
+
+
+      // Restores the subtree in slot, whose root is unshared, after its left
+      // subtree lost a black node, by borrowing one from the right. Returns
+      // whether the subtree is still a black node short.
+      static bool FixedLeft(TreeType& slot) {
+        auto* node = Mutable(slot);
+        if (IsRed(node->left)) {
+          Recoloured(Unique(node->left), Colour::Black);
+          Recounted(node);
+          return false;
+        }
+        auto* sibling = Unique(node->right);
+        if (sibling->colour == Colour::Red) {
+          TreeType top = std::move(node->right);
+          node->right = std::move(sibling->left);
+          Recoloured(node, Colour::Red);
+          sibling->left = std::move(slot);
+          FixedLeft(sibling->left);
+          Recoloured(sibling, Colour::Black);
+          slot = std::move(top);
+          return false;
+        }
+        else if (IsRed(sibling->right)) {
+          Recoloured(Unique(sibling->right), Colour::Black);
+          TreeType top = std::move(node->right);
+          node->right = std::move(sibling->left);
+          const auto colour = node->colour;
+          Recoloured(node, Colour::Black);
+          sibling->left = std::move(slot);
+          Recoloured(sibling, colour);
+          slot = std::move(top);
+          return false;
+        }
+        else if (IsRed(sibling->left)) {
+          TreeType top = std::move(sibling->left);
+          auto* near = Unique(top);
+          sibling->left = std::move(near->right);
+          Recoloured(sibling, Colour::Black);
+          near->right = std::move(node->right);
+          node->right = std::move(near->left);
+          const auto colour = node->colour;
+          Recoloured(node, Colour::Black);
+          near->left = std::move(slot);
+          Recoloured(near, colour);
+          slot = std::move(top);
+          return false;
+        }
+        else {
+          Recoloured(sibling, Colour::Red);
+          const auto short_of_black = node->colour == Colour::Black;
+          Recoloured(node, Colour::Black);
+          return short_of_black;
+        }
+      }
+
+      static bool FixedRight(TreeType& slot) {
+        auto* node = Mutable(slot);
+        if (IsRed(node->right)) {
+          Recoloured(Unique(node->right), Colour::Black);
+          return false;
+        }
+        auto* sibling = Unique(node->left);
+        if (sibling->colour == Colour::Red) {
+          TreeType top = std::move(node->left);
+          node->left = std::move(sibling->right);
+          Recoloured(node, Colour::Red);
+          sibling->right = std::move(slot);
+          FixedRight(sibling->right);
+          Recoloured(sibling, Colour::Black);
+          slot = std::move(top);
+          return false;
+        }
+        else if (IsRed(sibling->left)) {
+          Recoloured(Unique(sibling->left), Colour::Black);
+          TreeType top = std::move(node->left);
+          node->left = std::move(sibling->right);
+          const auto colour = node->colour;
+          Recoloured(node, Colour::Black);
+          sibling->right = std::move(slot);
+          Recoloured(sibling, colour);
+          slot = std::move(top);
+          return false;
+        }
+        else if (IsRed(sibling->right)) {
+          TreeType top = std::move(sibling->right);
+          auto* near = Unique(top);
+          sibling->right = std::move(near->left);
+          Recoloured(sibling, Colour::Black);
+          near->left = std::move(node->left);
+          node->left = std::move(near->right);
+          const auto colour = node->colour;
+          Recoloured(node, Colour::Black);
+          near->right = std::move(slot);
+          Recoloured(near, colour);
+          slot = std::move(top);
+          return false;
+        }
+        else {
+          Recoloured(sibling, Colour::Red);
+          const auto short_of_black = node->colour == Colour::Black;
+          Recoloured(node, Colour::Black);
+          return short_of_black;
+        }
+      }
+
+      // Replaces the unshared node in slot, which has at most one child, by
+      // that child. Returns whether the subtree lost a black node.
+      static bool Unlinked(TreeType& slot) {
+        auto* node = Mutable(slot);
+        const auto black = node->colour == Colour::Black;
+        TreeType child = std::move(node->left.empty() ? node->right : node->left);
+        slot = std::move(child);
+        if (!black) {
+          return false;
+        }
+        else if (!slot.empty()) {
+          Recoloured(Unique(slot), Colour::Black);
+          return false;
+        }
+        else {
+          return true;
+        }
+      }
+
+      static bool RemovingFirst(TreeType& slot, T& first) {
+        auto* node = Unique(slot);
+        if (!node->left.empty()) {
+          const auto short_of_black = RemovingFirst(node->left, first);
+          Recounted(node);
+          return short_of_black && FixedLeft(slot);
+        }
+        else {
+          first = std::move(node->value);
+          return Unlinked(slot);
+        }
+      }
+
+      // Returns whether the subtree lost a black node. Precondition: value
+      // is in the subtree.
+      static bool Removing(TreeType& slot, T const& value) {
+        auto* node = Unique(slot);
+        if (Less(value, node->value)) {
+          const auto short_of_black = Removing(node->left, value);
+          Recounted(node);
+          return short_of_black && FixedLeft(slot);
+        }
+        else if (Less(node->value, value)) {
+          const auto short_of_black = Removing(node->right, value);
+          Recounted(node);
+          return short_of_black && FixedRight(slot);
+        }
+        else if (!node->left.empty() && !node->right.empty()) {
+          const auto short_of_black = RemovingFirst(node->right, node->value);
+          Recounted(node);
+          return short_of_black && FixedRight(slot);
+        }
+        else {
+          return Unlinked(slot);
+        }
+      }
+
+      void blacken_root() {
+        if (IsRed(root_)) {
+          Recoloured(Unique(root_), Colour::Black);
+        }
+      }
+
+    public:
+      TreeBuilder() = default;
+      explicit TreeBuilder(TreeType tree) noexcept : root_{std::move(tree)} {}
+
+      bool empty() const noexcept { return root_.empty(); }
+
+      template<class Key>
+        bool has(Key const& key) const {
+          return Has(root_, key);
+        }
+
+      // Keeps the value there when there is an equal one.
+      void insert(T value) {
+        Inserting(root_, value);
+        blacken_root();
+      }
+
+      void remove(T const& value) {
+        if (Has(root_, value)) {
+          Removing(root_, value);
+          blacken_root();
+        }
+      }
+
+      // The values so far, sharing all the nodes. It is a tree of its own,
+      // which changes to the builder afterwards copy their way around.
+      TreeType tree() const noexcept {
+        return root_;
+      }
+    };
+} // Generics
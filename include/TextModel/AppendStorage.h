@@ -0,0 +1,61 @@
+#pragma once
+
+#include "TextModel/Buffer.h"
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace TextModel {
+  // Append-only text storage made of blocks that never move, so appending
+  // costs the same however much is stored and views stay valid forever.
+  //
+  // Offsets are logical: block i covers [i * BlockSize, (i + 1) * BlockSize).
+  // A text that does not fit the rest of the current block starts a new one
+  // (several slots long if it is larger than a block), so every append is a
+  // single contiguous run and the skipped tail of the old block is left unused.
+  // When the old block is full, an empty slot is skipped instead: offsets that
+  // follow each other are always next to each other in memory.
+  //
+  // The block directory is never changed once it is published: a new
+  // allocation replaces it with a longer copy. A directory taken with blocks()
+  // thus stays readable from other threads, for everything stored before it
+  // was taken, while the storage keeps appending.
+  class AppendStorage {
+  public:
+    static constexpr Index BlockSize{64 * 1024};
+    // The start of every block slot, each one sharing its allocation.
+    using Blocks = std::vector<std::shared_ptr<char>>;
+
+  private:
+    std::shared_ptr<const Blocks> blocks_;
+    Index end_{0};
+    Index limit_{0};
+
+  public:
+    AppendStorage() = default;
+    // Copies would append into the same blocks.
+    AppendStorage(AppendStorage const&) = delete;
+    AppendStorage& operator=(AppendStorage const&) = delete;
+    AppendStorage(AppendStorage&&) = default;
+    AppendStorage& operator=(AppendStorage&&) = default;
+
+    // Copies text in and returns the offset of its first byte.
+    Index append(std::string_view text);
+
+    // A run of bytes that was stored by a single append, or by appends that
+    // directly followed each other in the same block.
+    std::string_view view(Index start, Index length) const {
+      return ViewOf(*blocks_, start, length);
+    }
+
+    static std::string_view ViewOf(Blocks const& blocks, Index start, Index length) {
+      return {blocks[start / BlockSize].get() + start % BlockSize, length};
+    }
+
+    // The current directory, O(1). Null before the first allocation.
+    std::shared_ptr<const Blocks> blocks() const noexcept { return blocks_; }
+
+    // The logical end of the stored text.
+    Index size() const noexcept { return end_; }
+  };
+} // TextModel
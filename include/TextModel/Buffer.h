@@ -1,7 +1,11 @@
 #pragma once
 
 #include "TextModel/String.h"
+#include <algorithm>
 #include <cstddef>
+#include <functional>
+#include <string_view>
+#include <vector>
 
 namespace TextModel {
   using Index = std::size_t;
@@ -11,15 +15,69 @@ namespace TextModel {
     Index end;
   };
 
-  struct Buffer {
-    virtual ~Buffer() = default;
-    virtual void insert(Index, String) = 0;
-    virtual void remove(Range const&) = 0;
+  // Lines and columns count from zero, columns in bytes.
+  struct Position {
+    Index line;
+    Index column;
+  };
+
+  // Replaces range with text. In a batch every range is given in offsets of the
+  // text before the batch.
+  struct Edit {
+    Range range;
+    String text;
+  };
+
+  // Receives the text of a range in consecutive pieces. The views point into
+  // the buffer's own storage and are only valid while the buffer lives.
+  using ChunkVisitor = std::function<void(std::string_view)>;
+
+  // The reading half of a buffer: all that searching, saving or a snapshot
+  // handed to another thread needs.
+  struct ReadOnlyBuffer {
+    virtual ~ReadOnlyBuffer() = default;
     virtual String text_of(Range const&) const = 0;
     virtual Index size() const = 0;
+    virtual void for_each_chunk(Range const&, ChunkVisitor const&) const = 0;
+
+    // Appends the text of range to into, growing it at most once.
+    void text_of(Range const& range, String& into) const {
+      const auto end = std::min(range.end, size());
+      if (range.start < end) {
+        into.reserve(into.size() + (end - range.start));
+      }
+      for_each_chunk(range, [&into](std::string_view chunk) {
+        into.append(chunk.data(), chunk.size());
+      });
+    }
+  };
+
+  struct Buffer
+  : public ReadOnlyBuffer
+  {
+    virtual void insert(Index, std::string_view) = 0;
+    virtual void remove(Range const&) = 0;
+
+    // Applies edits sorted by position and not overlapping each other, with
+    // the same result as applying them one by one from the last to the first.
+    virtual void apply(std::vector<Edit> const&) = 0;
+
+    virtual Index line_count() const = 0;
+    virtual Index offset_of_line(Index line) const = 0;
+    virtual Position position_of(Index offset) const = 0;
+
+    // Conversions between byte offsets and the code point and UTF-16 unit
+    // offsets of editor front ends and language servers. A byte offset maps to
+    // the number of code points, or their UTF-16 units, starting before it; a
+    // UTF-16 offset in the middle of a surrogate pair maps to the start of its
+    // code point. Offsets past the end throw std::out_of_range.
+    virtual Index code_point_index_of(Index offset) const = 0;
+    virtual Index offset_of_code_point(Index code_point) const = 0;
+    virtual Index utf16_index_of(Index offset) const = 0;
+    virtual Index offset_of_utf16_index(Index unit) const = 0;
   };
 
-  inline String FullTextOf(Buffer const& buffer) {
+  inline String FullTextOf(ReadOnlyBuffer const& buffer) {
     return buffer.text_of(Range{0, buffer.size()});
   }
-} // TextModel
\ No newline at end of file
+} // TextModel
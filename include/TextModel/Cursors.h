@@ -0,0 +1,19 @@
+#pragma once
+
+#include "TextModel/Buffer.h"
+#include <vector>
+
+namespace TextModel {
+  // Cursor positions as document offsets. The functions below sort them and
+  // drop duplicates, and return the new cursor positions in the same order.
+  using Cursors = std::vector<Index>;
+
+  // Inserts text at every cursor in one batch and returns the cursors moved
+  // right after the text they inserted.
+  Cursors InsertAtCursors(Buffer& buffer, Cursors cursors, String const& text);
+
+  // Removes up to before code points in front of and after code points
+  // behind every cursor in one batch. Cursors whose ranges overlap end up
+  // merged.
+  Cursors RemoveAtCursors(Buffer& buffer, Cursors cursors, Index before, Index after);
+} // TextModel
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "TextModel/Buffer.h"
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+namespace TextModel {
+  // The number of '\n' characters in text.
+  Index CountLineBreaks(std::string_view text);
+
+
+  // Line breaks of an append-only storage before every Stride-th offset, so
+  // that counting them in any part of it, or finding the n-th, takes a binary
+  // search and a scan of at most Stride bytes, and the index stays a small
+  // fraction of the storage however short its lines. Every '\n' is a line
+  // break.
+  //
+  // Bytes skipped between appends hold no line breaks. Queries read the
+  // storage through view(start, length), which has to return the bytes
+  // stored there.
+  class LineBreaks {
+  public:
+    static constexpr Index Stride{512};
+
+  private:
+    // checkpoints_[i] holds the number of line breaks in [0, i * Stride).
+    std::vector<Index> checkpoints_{0};
+    Index total_{0};
+    Index end_{0};
+
+    // Offset in text of its n-th line break, counting from zero.
+    static Index NthLineBreakIn(std::string_view text, Index n);
+
+  public:
+    // Records the line breaks of text that was appended to the storage at
+    // offset, which is not before the end of the previous append, and returns
+    // how many it found.
+    Index append(std::string_view text, Index offset);
+
+    // The number of line breaks of the storage before offset.
+    template<class View>
+      Index count_before(Index offset, View const& view) const {
+        const auto checkpoint = offset / Stride;
+        const auto start = checkpoint * Stride;
+        return offset == start
+            ? checkpoints_[checkpoint]
+            : checkpoints_[checkpoint] + CountLineBreaks(view(start, offset - start))
+        ;
+      }
+
+    // Offset of the n-th line break of the storage, counting from zero; n has
+    // to be less than size().
+    template<class View>
+      Index offset_of(Index n, View const& view) const {
+        const auto after = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), n);
+        const auto checkpoint = static_cast<Index>(after - checkpoints_.begin()) - 1;
+        const auto start = checkpoint * Stride;
+        return start + NthLineBreakIn(
+            view(start, std::min(Stride, end_ - start)),
+            n - checkpoints_[checkpoint]
+        );
+      }
+
+    Index size() const noexcept { return total_; }
+  };
+} // TextModel
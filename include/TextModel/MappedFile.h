@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace TextModel {
+  // Read-only private memory mapping of a whole file. Pages are loaded by the
+  // kernel on first access and stay out of the process heap. The file must not
+  // be truncated by others while mapped.
+  class MappedFile {
+    char const* data_{nullptr};
+    std::size_t size_{0};
+
+  public:
+    // Throws std::system_error when the file cannot be opened or mapped.
+    explicit MappedFile(std::string const& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    std::string_view text() const noexcept { return {data_, size_}; }
+  };
+} // TextModel
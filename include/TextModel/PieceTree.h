@@ -0,0 +1,175 @@
+#pragma once
+
+#include "TextModel/Buffer.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace TextModel {
+  enum class Storage {
+    Original, Inserted
+  };
+
+  struct Span {
+    Storage storage;
+    Index start_in_storage;
+    Index length;
+    Index line_breaks;
+    Index code_points;
+    Index utf16_units;
+
+    Span(
+        Storage which, Index s, Index l,
+        Index breaks = 0, Index points = 0, Index units = 0
+    )
+    : storage{which}
+    , start_in_storage{s}
+    , length{l}
+    , line_breaks{breaks}
+    , code_points{points}
+    , utf16_units{units} {}
+  };
+
+
+  // Creates the span for a part of a storage with its cached counts filled in.
+  // The piece tree calls it when it has to cut a piece in two.
+  using SpanMeasure = std::function<Span(Storage, Index start, Index length)>;
+
+
+  // Immutable, height balanced (AVL) sequence of spans. Every node caches the
+  // total length, line break, code point, UTF-16 unit and piece count of its
+  // subtree, so finding the piece under any of these offsets, splitting and
+  // joining are all logarithmic in the number of pieces. Nodes are shared
+  // between versions the same way Generics::Tree shares them.
+  class PieceTree {
+  public:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+    struct Node {
+      NodePtr left;
+      Span piece;
+      NodePtr right;
+      Index length;
+      Index line_breaks;
+      Index code_points;
+      Index utf16_units;
+      std::size_t pieces;
+      std::size_t height;
+
+      Node(NodePtr lhs, Span p, NodePtr rhs) noexcept;
+    };
+
+  private:
+    NodePtr root_;
+
+  public:
+    PieceTree() = default;
+    PieceTree(PieceTree const& lhs, Span piece, PieceTree const& rhs);
+    explicit PieceTree(NodePtr root) noexcept : root_{std::move(root)} {}
+    // Builds a perfectly balanced tree of the pieces in linear time.
+    explicit PieceTree(std::vector<Span> const& pieces);
+
+    bool empty() const noexcept { return !root_; }
+    Span const& root() const noexcept { return root_->piece; }
+    PieceTree left() const noexcept { return PieceTree{root_->left}; }
+    PieceTree right() const noexcept { return PieceTree{root_->right}; }
+    Index length() const noexcept { return root_ ? root_->length : 0; }
+    Index line_breaks() const noexcept { return root_ ? root_->line_breaks : 0; }
+    Index code_points() const noexcept { return root_ ? root_->code_points : 0; }
+    Index utf16_units() const noexcept { return root_ ? root_->utf16_units : 0; }
+    std::size_t pieces() const noexcept { return root_ ? root_->pieces : 0; }
+    std::size_t height() const noexcept { return root_ ? root_->height : 0; }
+    NodePtr const& node() const noexcept { return root_; }
+
+    bool operator==(PieceTree const& rhs) const { return root_ == rhs.root_; }
+    bool operator!=(PieceTree const& rhs) const { return root_ != rhs.root_; }
+  };
+
+
+  // lhs, piece, rhs in this order, rebalanced.
+  PieceTree Joined(PieceTree const& lhs, Span const& piece, PieceTree const& rhs);
+
+  PieceTree Concatenated(PieceTree const& lhs, PieceTree const& rhs);
+
+  // Splits off the last piece of a non-empty tree.
+  std::pair<PieceTree, Span> SplitLast(PieceTree const& tree);
+
+  // Splits the sequence into [0, index) and [index, length), cutting the piece
+  // under index in two when index falls into its middle.
+  std::pair<PieceTree, PieceTree> SplitAt(
+      PieceTree const& tree, Index index, SpanMeasure const& measure
+  );
+
+
+  struct PiecePosition {
+    Span piece;
+    Index offset;
+    Index line_breaks_before;
+    Index code_points_before;
+    Index utf16_units_before;
+  };
+
+  // The piece covering index, which has to be less than the tree's length.
+  PiecePosition PieceAt(PieceTree const& tree, Index index);
+
+  // The piece holding the n-th line break (counting from zero) of the sequence,
+  // n has to be less than the tree's line break count.
+  PiecePosition PieceWithLineBreak(PieceTree const& tree, Index n);
+
+  // The piece holding the n-th code point, n less than the tree's count.
+  PiecePosition PieceWithCodePoint(PieceTree const& tree, Index n);
+
+  // The piece holding the n-th UTF-16 unit, n less than the tree's count.
+  PiecePosition PieceWithUtf16Unit(PieceTree const& tree, Index n);
+
+  // Recomputes every cached count and height from the spans themselves and
+  // checks them, together with the balance, against what the nodes hold.
+  // Linear in the number of pieces; meant for consistency checking only.
+  bool IsConsistent(PieceTree const& tree);
+
+
+  namespace Detail {
+    template<class Function>
+      void ForEachPiece(
+          PieceTree::Node const* node, Index offset,
+          Range const& range, Function& function
+      ) {
+        if (!node || range.end <= offset || offset + node->length <= range.start) {
+          return;
+        }
+
+        ForEachPiece(node->left.get(), offset, range, function);
+
+        const auto left_length = node->left ? node->left->length : 0;
+        const auto piece_start = offset + left_length;
+        const auto piece_end = piece_start + node->piece.length;
+        if (range.start < piece_end && piece_start < range.end) {
+          const auto from = std::max(range.start, piece_start);
+          const auto to = std::min(range.end, piece_end);
+          if (from == piece_start && to == piece_end) {
+            function(node->piece);
+          }
+          else {
+            function(Span{
+                node->piece.storage,
+                node->piece.start_in_storage + (from - piece_start),
+                to - from
+            });
+          }
+        }
+
+        ForEachPiece(node->right.get(), piece_end, range, function);
+      }
+  } // Detail
+
+
+  // Calls function with every piece overlapping range, in document order, each
+  // one trimmed to the part that falls inside the range. Trimmed pieces do not
+  // carry any of the cached counts.
+  template<class Function>
+    void ForEachPiece(PieceTree const& tree, Range const& range, Function function) {
+      Detail::ForEachPiece(tree.node().get(), 0, range, function);
+    }
+} // TextModel
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "TextModel/Buffer.h"
+#include <string>
+
+namespace TextModel {
+  // Writes the text of buffer to path chunk by chunk, straight from the
+  // buffer's storage with batched writev calls, so it takes no extra memory
+  // however large the text is. The text goes to a temporary file next to path
+  // first, which is synced and then renamed over path, so readers see either
+  // the old or the new content, and the directory is synced after the
+  // rename. A symbolic link is saved through: the file it points to is
+  // replaced and the link stays. An existing file keeps its permissions, and
+  // its owner and group as far as the process may set them; a new one gets
+  // its permissions from the umask. A buffer mapping the file it is saved
+  // over keeps reading the old content.
+  //
+  // Throws std::system_error and leaves path untouched on failure, except
+  // when syncing the directory fails: path holds the new content by then.
+  void SaveToFile(ReadOnlyBuffer const& buffer, std::string const& path);
+} // TextModel
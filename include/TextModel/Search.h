@@ -0,0 +1,21 @@
+#pragma once
+
+#include "TextModel/Buffer.h"
+#include <string_view>
+#include <vector>
+
+namespace TextModel {
+  constexpr Index NotFound{static_cast<Index>(-1)};
+
+  // Searching reads the buffer chunk by chunk without copying it, using AVX2
+  // or SSE2 when the compiler targets them, and also finds matches straddling
+  // piece boundaries. Matches do not overlap: after a match the search goes on
+  // behind its end. An empty needle matches nothing.
+
+  // The first match at or after from, or NotFound.
+  Index FindNext(ReadOnlyBuffer const& buffer, std::string_view needle, Index from = 0);
+
+  std::vector<Index> FindAll(ReadOnlyBuffer const& buffer, std::string_view needle);
+
+  Index CountOf(ReadOnlyBuffer const& buffer, std::string_view needle);
+} // TextModel
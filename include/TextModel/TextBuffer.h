@@ -1,51 +1,154 @@
 #pragma once
 
+#include "TextModel/AppendStorage.h"
 #include "TextModel/Buffer.h"
-#include "Generics/Algorithms.h"
-#include <list>
-#include <numeric>
+#include "TextModel/LineBreaks.h"
+#include "TextModel/MappedFile.h"
+#include "TextModel/PieceTree.h"
+#include "TextModel/Utf8.h"
+#include <memory>
+#include <vector>
 
 namespace TextModel {
-  enum class Storage {
-    Original, Inserted
-  };
-
-  struct Span {
-    Storage storage;
-    Index start_in_storage;
-    Index length; 
-
-    Span(Storage which, Index s, Index l)
-    : storage{which}
-    , start_in_storage{s}
-    , length{l} {}
-  };
-
-
   class TextBuffer
   : public Buffer
   {
-    String original_;
-    String inserted_;
+    // Keeps the bytes of original_ alive: either a String or a MappedFile.
+    std::shared_ptr<const void> original_owner_;
+    std::string_view original_;
+    AppendStorage inserted_;
+    LineBreaks original_line_breaks_;
+    LineBreaks inserted_line_breaks_;
+    Utf8Index original_utf8_;
+    Utf8Index inserted_utf8_;
+    PieceTree pieces_;
+    std::vector<PieceTree> undo_;
+    std::vector<PieceTree> redo_;
+    // Whether the last step was an insertion, which typing right after it
+    // joins.
+    bool typing_{false};
 
-    using PieceList = std::list<Span>;
-    PieceList pieces_;
+    std::string_view view_of(Storage storage, Index start, Index length) const;
+    std::string_view view_of(Span const& piece) const;
+    LineBreaks const& line_breaks_of(Storage storage) const;
+    Utf8Index const& utf8_index_of(Storage storage) const;
+    Index line_breaks_before(Storage storage, Index start) const;
+    Utf8Counts utf8_counts_before(Storage storage, Index start) const;
+    Span span_of(Storage storage, Index start, Index length) const;
+    SpanMeasure span_measure() const;
 
-    String text_of(Span const& piece) const;
+    // Stores text, which has to be valid UTF-8, and returns its span.
+    Span appended(std::string_view text);
 
-    using ListPosition = std::pair<PieceList::const_iterator, Index>;
-    ListPosition piece_at(Index index) const;
+    // Throws std::invalid_argument when offset is inside a code point.
+    void check_boundary(Index offset) const;
 
-    using MutListPosition = std::pair<PieceList::iterator, Index>;
-    MutListPosition piece_at(Index index);
+    // The counts of the text before offset, which is at most size().
+    Utf8Counts counts_before(Index offset) const;
+
+    // Throws std::logic_error when the cached lengths disagree with the spans.
+    // Only called after edits when TEXTMODEL_CONSISTENCY_CHECKS is defined.
+    void check_consistency() const;
+
+    void adopt_original(std::shared_ptr<const void> owner, std::string_view original);
+
+    // Makes pieces the current text as a new undoable step.
+    void commit(PieceTree pieces);
+    // Makes pieces the current text as part of the last step.
+    void amend(PieceTree pieces);
   
   public:
+    // A version of the text. Both storages are append-only and the piece tree
+    // is immutable, so a snapshot is the root of the tree it had plus shared
+    // ownership of the storages, and taking one is O(1). Nothing it reads is
+    // ever written again: any number of threads can read a snapshot without
+    // locking while the buffer keeps being edited, and it stays readable after
+    // the buffer is gone.
+    class Snapshot
+    : public ReadOnlyBuffer
+    {
+      PieceTree pieces_;
+      std::shared_ptr<const void> original_owner_;
+      std::string_view original_;
+      std::shared_ptr<const AppendStorage::Blocks> inserted_;
+
+      Snapshot(
+          PieceTree pieces,
+          std::shared_ptr<const void> original_owner, std::string_view original,
+          std::shared_ptr<const AppendStorage::Blocks> inserted
+      );
+      friend class TextBuffer;
+
+      std::string_view view_of(Span const& piece) const;
+
+    public:
+      using ReadOnlyBuffer::text_of;
+
+      String text_of(Range const& range) const override;
+      Index size() const override { return pieces_.length(); }
+      void for_each_chunk(Range const& range, ChunkVisitor const& visitor) const override;
+
+      bool operator==(Snapshot const& rhs) const { return pieces_ == rhs.pieces_; }
+      bool operator!=(Snapshot const& rhs) const { return pieces_ != rhs.pieces_; }
+    };
+
     TextBuffer() = default;
     explicit TextBuffer(String);
+    // Edits a file without copying it: the original text stays in the
+    // mapping and only inserted text lives on the heap, along with indexes of
+    // about 5% of the file's size. Opening reads every page of the file once,
+    // a chunk at a time, as the piece tree needs the counts of lines and code
+    // points of the whole original up front.
+    explicit TextBuffer(MappedFile);
+
+    // The original text is taken as it is. Edits keep the text well-formed:
+    // they throw std::invalid_argument for text that is not valid UTF-8 (see
+    // RepairedUtf8) and for offsets inside a code point. Every maximal
+    // ill-formed subpart of the original counts as one code point and one
+    // UTF-16 unit, like the U+FFFD that RepairedUtf8 puts in its place. An
+    // offset inside a four byte sequence maps past the first of its two
+    // UTF-16 units only.
+
+    using Buffer::text_of;
 
-    void insert(Index index, String text) override;
+    void insert(Index index, std::string_view text) override;
     void remove(Range const& range) override;
     String text_of(Range const& range) const override;
     Index size() const override;
+    void for_each_chunk(Range const& range, ChunkVisitor const& visitor) const override;
+    // Rebuilds the pieces in one pass over them, linear in pieces plus edits,
+    // as a single undo step. Throws std::invalid_argument for unsorted or
+    // overlapping edits.
+    void apply(std::vector<Edit> const& edits) override;
+
+    // Replaces every non-overlapping match of pattern in one pass over the
+    // pieces, as a single undo step. The replacement is stored once and all
+    // the new pieces refer to it. Returns the number of replacements.
+    Index replace_all(std::string_view pattern, std::string_view replacement);
+
+    // Line queries throw std::out_of_range for lines at or after line_count()
+    // and offsets after size().
+    Index line_count() const override;
+    Index offset_of_line(Index line) const override;
+    Position position_of(Index offset) const override;
+
+    Index code_point_index_of(Index offset) const override;
+    Index offset_of_code_point(Index code_point) const override;
+    Index utf16_index_of(Index offset) const override;
+    Index offset_of_utf16_index(Index unit) const override;
+
+    std::size_t piece_count() const noexcept { return pieces_.pieces(); }
+
+    // Every edit is one undo step, except that typing right after the
+    // previous insertion joins its step; all of these are O(1). Only
+    // snapshots of this buffer can be restored.
+    Snapshot snapshot() const;
+    void restore(Snapshot const& snapshot);
+    bool can_undo() const noexcept { return !undo_.empty(); }
+    bool can_redo() const noexcept { return !redo_.empty(); }
+    bool undo();
+    bool redo();
+    // Drops every undo and redo step, and the text they alone kept alive.
+    void clear_history();
   };
-} // TextModel
\ No newline at end of file
+} // TextModel
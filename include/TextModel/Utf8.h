@@ -0,0 +1,139 @@
+#pragma once
+
+#include "TextModel/Buffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace TextModel {
+  // Code points and UTF-16 code units in a run of UTF-8 text. Every
+  // well-formed sequence and every maximal ill-formed subpart counts as one
+  // code point, as the U+FFFD replacing it would, and four byte sequences
+  // take two UTF-16 units, the second one with their last byte.
+  struct Utf8Counts {
+    Index code_points;
+    Index utf16_units;
+  };
+
+  inline Utf8Counts operator+(Utf8Counts const& lhs, Utf8Counts const& rhs) {
+    return {lhs.code_points + rhs.code_points, lhs.utf16_units + rhs.utf16_units};
+  }
+
+  inline Utf8Counts operator-(Utf8Counts const& lhs, Utf8Counts const& rhs) {
+    return {lhs.code_points - rhs.code_points, lhs.utf16_units - rhs.utf16_units};
+  }
+
+
+  inline bool IsContinuationByte(char byte) {
+    return (static_cast<unsigned char>(byte) & 0xC0) == 0x80;
+  }
+
+  // Where counting stands after some bytes: how many more continuation bytes
+  // the sequence in progress takes, the range the next one has to be in, and
+  // whether the sequence is four bytes long.
+  struct Utf8State {
+    std::uint8_t pending{0};
+    std::uint8_t low{0x80};
+    std::uint8_t high{0xBF};
+    bool four_byte{false};
+  };
+
+  Utf8Counts CountUtf8(std::string_view text);
+
+  // Counts text that follows bytes that left state behind, and updates it.
+  Utf8Counts CountUtf8(std::string_view text, Utf8State& state);
+
+  // Well-formed UTF-8 as the Unicode standard defines it: no overlong forms,
+  // surrogates or code points past U+10FFFF.
+  bool IsValidUtf8(std::string_view text);
+
+  // The text with every maximal ill-formed subsequence replaced by U+FFFD.
+  String RepairedUtf8(std::string_view text);
+
+  // Whether offset is inside a code point of text, that is inside a
+  // well-formed sequence or a maximal ill-formed subpart. Text has to hold
+  // the three bytes in front of offset and the three from it on where there
+  // are any.
+  bool IsInsideCodePoint(std::string_view text, Index offset);
+
+
+  // Counts of an append-only storage before every Stride-th offset, so that
+  // the counts of any part of it, or the offset of its n-th code point, take a
+  // binary search and a scan of at most Stride bytes.
+  //
+  // Every checkpoint also keeps the state counting was in there, as a
+  // sequence may run across it. Bytes skipped between appends count as
+  // nothing, and counting starts afresh after them. Queries read the storage
+  // through view(start, length), which has to return the bytes stored there;
+  // a stride never reaches from before a skipped run into the text after it
+  // as long as appends after a gap start at a multiple of Stride.
+  class Utf8Index {
+  public:
+    static constexpr Index Stride{512};
+
+  private:
+    struct Checkpoint {
+      Utf8Counts counts;
+      Utf8State state;
+    };
+
+    // checkpoints_[i] holds the counts of [0, i * Stride).
+    std::vector<Checkpoint> checkpoints_{Checkpoint{{0, 0}, {}}};
+    Utf8Counts total_{0, 0};
+    Utf8State state_;
+    Index end_{0};
+
+    // Offset of the code point holding the n-th code point or UTF-16 unit,
+    // found in window, the bytes of the storage from the checkpoint at start
+    // on. That code point may start before the window when the checkpoint is
+    // inside it.
+    static Index OffsetIn(std::string_view window, Index start, Checkpoint const& checkpoint, Index n, bool utf16);
+
+    template<class View>
+      Index offset_of(Index n, bool utf16, View const& view) const {
+        const auto after = std::upper_bound(
+            checkpoints_.begin(), checkpoints_.end(), n,
+            [utf16](Index n, Checkpoint const& checkpoint) {
+              return n < (utf16 ? checkpoint.counts.utf16_units : checkpoint.counts.code_points);
+            }
+        );
+        const auto checkpoint = static_cast<Index>(after - checkpoints_.begin()) - 1;
+        const auto start = checkpoint * Stride;
+        return OffsetIn(
+            view(start, std::min(Stride, end_ - start)), start,
+            checkpoints_[checkpoint], n, utf16
+        );
+      }
+
+  public:
+    // Records text that was appended to the storage at offset, which is not
+    // before the end of the previous append, and returns its counts.
+    Utf8Counts append(std::string_view text, Index offset);
+
+    // The counts of the storage before offset.
+    template<class View>
+      Utf8Counts counts_before(Index offset, View const& view) const {
+        const auto checkpoint = offset / Stride;
+        const auto start = checkpoint * Stride;
+        if (offset == start) {
+          return checkpoints_[checkpoint].counts;
+        }
+        auto state = checkpoints_[checkpoint].state;
+        return checkpoints_[checkpoint].counts + CountUtf8(view(start, offset - start), state);
+      }
+
+    // Offset of the n-th code point of the storage, counting from zero; n has
+    // to be less than the number of code points stored.
+    template<class View>
+      Index offset_of_code_point(Index n, View const& view) const {
+        return offset_of(n, false, view);
+      }
+
+    // Offset of the code point holding the n-th UTF-16 unit of the storage.
+    template<class View>
+      Index offset_of_utf16_unit(Index n, View const& view) const {
+        return offset_of(n, true, view);
+      }
+  };
+} // TextModel
@@ -0,0 +1,172 @@
+#include "catch2/catch.hpp"
+
+#include "Generics/Diff.h"
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+  using TreeOfIntegers = Generics::Tree<int>;
+
+  struct Changes {
+    std::vector<int> removed;
+    std::vector<int> added;
+    // Every value reported, in the order reported.
+    std::vector<int> all;
+  };
+
+  Changes ChangesBetween(TreeOfIntegers const& before, TreeOfIntegers const& after) {
+    Changes changes;
+    Generics::Diff(before, after,
+        [&changes](int value) {
+          changes.removed.push_back(value);
+          changes.all.push_back(value);
+        },
+        [&changes](int value) {
+          changes.added.push_back(value);
+          changes.all.push_back(value);
+        }
+    );
+    return changes;
+  }
+} // anonymous namespace
+
+
+TEST_CASE("Diffing two versions of a tree") {
+  std::vector<int> values(5000);
+  std::iota(values.begin(), values.end(), 0);
+  const TreeOfIntegers original{values.begin(), values.end()};
+
+  SECTION("finds nothing between a tree and itself") {
+    const auto changes = ChangesBetween(original, original);
+    REQUIRE(changes.all.empty());
+  }
+
+  SECTION("finds everything against the empty tree") {
+    const auto added = ChangesBetween(TreeOfIntegers{}, original);
+    REQUIRE(added.added == values);
+    REQUIRE(added.removed.empty());
+    const auto removed = ChangesBetween(original, TreeOfIntegers{});
+    REQUIRE(removed.removed == values);
+  }
+
+  SECTION("finds random edits in ascending order") {
+    std::mt19937 generator{22};
+    std::uniform_int_distribution<int> value(-100, 5100);
+    for (int round = 0; round < 20; ++round) {
+      auto edited = original;
+      std::set<int> expected(values.begin(), values.end());
+      for (int i = 0; i < round * 3; ++i) {
+        const auto v = value(generator);
+        if (i % 2 == 0) {
+          edited = Generics::Removed(edited, v);
+          expected.erase(v);
+        }
+        else {
+          edited = Generics::Inserted(edited, v);
+          expected.insert(v);
+        }
+      }
+
+      std::vector<int> removed;
+      std::set_difference(
+          values.begin(), values.end(), expected.begin(), expected.end(),
+          std::back_inserter(removed)
+      );
+      std::vector<int> added;
+      std::set_difference(
+          expected.begin(), expected.end(), values.begin(), values.end(),
+          std::back_inserter(added)
+      );
+      const auto changes = ChangesBetween(original, edited);
+      REQUIRE(changes.removed == removed);
+      REQUIRE(changes.added == added);
+      REQUIRE(std::is_sorted(changes.all.begin(), changes.all.end()));
+    }
+  }
+
+  SECTION("between trees built apart") {
+    const TreeOfIntegers rebuilt{values.rbegin(), values.rend()};
+    REQUIRE(ChangesBetween(original, rebuilt).all.empty());
+  }
+}
+
+
+TEST_CASE("Diffing two versions of a map reports changed values") {
+  const Generics::Map<int, std::string> before{{1, "one"}, {2, "two"}, {3, "three"}};
+  const auto after = Generics::Assigned(
+      Generics::Assigned(Generics::Removed(before, 1), 2, "deux"), 4, "four"
+  );
+  const auto same_value = Generics::Assigned(before, 3, "three");
+
+  std::vector<std::pair<int, std::string>> removed;
+  std::vector<std::pair<int, std::string>> added;
+  const auto collect = [](auto& into) {
+    return [&into](std::pair<int, std::string> const& entry) { into.push_back(entry); };
+  };
+  Generics::Diff(before, after, collect(removed), collect(added));
+  REQUIRE(removed == std::vector<std::pair<int, std::string>>{{1, "one"}, {2, "two"}});
+  REQUIRE(added == std::vector<std::pair<int, std::string>>{{2, "deux"}, {4, "four"}});
+
+  removed.clear();
+  added.clear();
+  Generics::Diff(before, same_value, collect(removed), collect(added));
+  REQUIRE(removed.empty());
+  REQUIRE(added.empty());
+}
+
+
+namespace {
+  // Has no operator==, so a changed entry cannot be told apart.
+  struct Opaque {
+    int value;
+  };
+} // anonymous namespace
+
+static_assert(Generics::Detail::IsEqualityComparable<std::pair<int, std::string>>::value);
+static_assert(!Generics::Detail::IsEqualityComparable<std::pair<int, Opaque>>::value);
+static_assert(!Generics::Detail::IsEqualityComparable<std::pair<Opaque, int>>::value);
+
+TEST_CASE("Diffing two versions of a map whose values have no operator==") {
+  const Generics::Map<int, Opaque> before{{1, {1}}, {2, {2}}};
+  const auto after = Generics::Assigned(Generics::Assigned(before, 2, Opaque{20}), 3, Opaque{3});
+
+  std::vector<int> removed;
+  std::vector<int> added;
+  Generics::Diff(before, after,
+      [&removed](std::pair<int, Opaque> const& entry) { removed.push_back(entry.first); },
+      [&added](std::pair<int, Opaque> const& entry) { added.push_back(entry.first); }
+  );
+  REQUIRE(removed.empty());
+  REQUIRE(added == std::vector<int>{3});
+}
+
+
+TEST_CASE("Benchmark diffing versions of a tree", "![benchmark]") {
+  std::vector<int> values(1000000);
+  std::iota(values.begin(), values.end(), 0);
+  const TreeOfIntegers original{values.begin(), values.end()};
+  auto edited = original;
+  for (int v = 0; v < 1000000; v += 100000) {
+    edited = Generics::Removed(edited, v + 1);
+  }
+
+  BENCHMARK("Diff of 1M value versions 10 removals apart") {
+    std::size_t changes{0};
+    Generics::Diff(original, edited, [&changes](int) { ++changes; }, [&changes](int) { ++changes; });
+    REQUIRE(changes == 10);
+  }
+  BENCHMARK("Comparing 1M value versions by iterating both") {
+    std::vector<int> removed;
+    std::set_difference(
+        original.begin(), original.end(), edited.begin(), edited.end(),
+        std::back_inserter(removed)
+    );
+    REQUIRE(removed.size() == 10);
+  }
+}
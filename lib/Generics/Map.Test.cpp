@@ -0,0 +1,116 @@
+#include "catch2/catch.hpp"
+
+#include "Generics/Map.h"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Maps map keys to values") {
+  const Generics::Map<int, std::string> map{{2, "two"}, {1, "one"}, {3, "three"}};
+  REQUIRE(*Generics::Find(map, 1) == "one");
+  REQUIRE(*Generics::Find(map, 3) == "three");
+  REQUIRE(Generics::Find(map, 4) == nullptr);
+  REQUIRE(Generics::Has(map, 2));
+  REQUIRE(!Generics::Has(map, 0));
+
+  SECTION("in the order of their keys") {
+    std::vector<int> keys;
+    for (auto const& [key, value] : map) {
+      keys.push_back(key);
+    }
+    REQUIRE(keys == std::vector<int>{1, 2, 3});
+    REQUIRE(map.lower_bound(2)->second == "two");
+    REQUIRE(map.upper_bound(2)->second == "three");
+  }
+
+  SECTION("leaving earlier versions as they were") {
+    const auto changed = Generics::Removed(Generics::Assigned(map, 2, "deux"), 3);
+    REQUIRE(*Generics::Find(changed, 2) == "deux");
+    REQUIRE(!Generics::Has(changed, 3));
+    REQUIRE(*Generics::Find(map, 2) == "two");
+    REQUIRE(Generics::Has(map, 3));
+    REQUIRE(Generics::Removed(map, 4) == map);
+  }
+}
+
+
+TEST_CASE("Maps follow random assignments and removals") {
+  std::mt19937 generator{21};
+  std::uniform_int_distribution<int> key(0, 1000);
+  Generics::Map<int, int> map;
+  std::map<int, int> expected;
+  for (int i = 0; i < 10000; ++i) {
+    const auto k = key(generator);
+    if (i % 4 == 3) {
+      map = Generics::Removed(map, k);
+      expected.erase(k);
+    }
+    else {
+      map = Generics::Assigned(map, k, i);
+      expected[k] = i;
+    }
+  }
+  REQUIRE(std::equal(
+      map.begin(), map.end(), expected.begin(), expected.end(),
+      [](auto const& lhs, auto const& rhs) { return lhs.first == rhs.first && lhs.second == rhs.second; }
+  ));
+}
+
+
+TEST_CASE("Maps with transparent comparators look up other key types") {
+  Generics::Map<std::string, int, std::less<>> map;
+  map = Generics::Assigned(map, "alpha", 1);
+  map = Generics::Assigned(map, "beta", 2);
+
+  const std::string_view beta{"beta"};
+  REQUIRE(*Generics::Find(map, beta) == 2);
+  REQUIRE(Generics::Find(map, "gamma") == nullptr);
+  REQUIRE(!Generics::Has(Generics::Removed(map, std::string_view{"alpha"}), "alpha"));
+}
+
+
+TEST_CASE("Maps order keys by their comparator") {
+  const Generics::Map<int, char, std::greater<int>> map{{1, 'a'}, {3, 'c'}, {2, 'b'}};
+  std::string values;
+  for (auto const& [key, value] : map) {
+    values += value;
+  }
+  REQUIRE(values == "cba");
+  REQUIRE(*Generics::Find(map, 2) == 'b');
+}
+
+
+TEST_CASE("Benchmark map lookups against std::map", "![benchmark]") {
+  static constexpr int Count{100000};
+  std::vector<std::string> keys;
+  for (int i = 0; i < Count; ++i) {
+    keys.push_back("key number " + std::to_string(i * 7919 % Count));
+  }
+  Generics::Map<std::string, int, std::less<>> map;
+  std::map<std::string, int, std::less<>> std_map;
+  for (int i = 0; i < Count; ++i) {
+    map = Generics::Assigned(map, keys[i], i);
+    std_map[keys[i]] = i;
+  }
+  std::vector<std::string_view> lookups(keys.begin(), keys.end());
+
+  BENCHMARK("Map, string_view lookups") {
+    long sum{0};
+    for (const auto key : lookups) {
+      sum += *Generics::Find(map, key);
+    }
+    REQUIRE(sum > 0);
+  }
+  BENCHMARK("std::map, string_view lookups") {
+    long sum{0};
+    for (const auto key : lookups) {
+      sum += std_map.find(key)->second;
+    }
+    REQUIRE(sum > 0);
+  }
+}
@@ -0,0 +1,92 @@
+#include "catch2/catch.hpp"
+
+#include "Generics/NodePool.h"
+#include <cstdint>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+  struct Payload {
+    long data[4];
+  };
+  using Pool = Generics::NodePool<Payload>;
+} // anonymous namespace
+
+
+TEST_CASE("A node pool reuses freed memory") {
+  auto* first = Pool::Allocate();
+  Pool::Deallocate(first);
+  REQUIRE(Pool::Allocate() == first);
+  Pool::Deallocate(first);
+
+  SECTION("and hands out distinct, aligned slots") {
+    std::set<void*> slots;
+    for (int i = 0; i < 1000; ++i) {
+      auto* slot = Pool::Allocate();
+      REQUIRE(reinterpret_cast<std::uintptr_t>(slot) % alignof(Payload) == 0);
+      slots.insert(slot);
+    }
+    REQUIRE(slots.size() == 1000);
+    for (auto* slot : slots) {
+      Pool::Deallocate(slot);
+    }
+  }
+}
+
+
+TEST_CASE("Nodes can be freed on other threads") {
+  std::vector<void*> slots;
+  std::thread allocating{[&slots]() {
+    for (int i = 0; i < 1000; ++i) {
+      slots.push_back(Pool::Allocate());
+    }
+  }};
+  allocating.join();
+
+  // The slots end up in the free list of the freeing thread, which passes
+  // them on when it ends.
+  std::thread freeing{[&slots]() {
+    for (auto* slot : slots) {
+      Pool::Deallocate(slot);
+    }
+  }};
+  freeing.join();
+
+  std::set<void*> reused;
+  std::thread reusing{[&reused]() {
+    std::vector<void*> taken;
+    for (int i = 0; i < 1000; ++i) {
+      taken.push_back(Pool::Allocate());
+    }
+    reused.insert(taken.begin(), taken.end());
+    for (auto* slot : taken) {
+      Pool::Deallocate(slot);
+    }
+  }};
+  reusing.join();
+  REQUIRE(reused.count(slots.front()) == 1);
+}
+
+
+TEST_CASE("Nodes freed on another thread go back to the allocating ones") {
+  constexpr std::size_t Count{10000};
+  std::set<void*> seen;
+  std::vector<void*> slots;
+  for (int round = 0; round < 20; ++round) {
+    std::thread allocating{[&slots]() {
+      for (std::size_t i = 0; i < Count; ++i) {
+        slots.push_back(Pool::Allocate());
+      }
+    }};
+    allocating.join();
+    seen.insert(slots.begin(), slots.end());
+
+    // This thread frees all of them every round, and keeps only a few.
+    for (auto* slot : std::exchange(slots, {})) {
+      Pool::Deallocate(slot);
+    }
+  }
+  REQUIRE(seen.size() < 2 * Count);
+}
@@ -0,0 +1,85 @@
+#include "catch2/catch.hpp"
+
+#include "Generics/ParallelAlgorithms.h"
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Reducing a tree in parallel") {
+  Generics::ThreadPool pool{4};
+  std::vector<long> values(100000);
+  std::iota(values.begin(), values.end(), 1);
+  const Generics::Tree<long> tree{values.begin(), values.end()};
+
+  SECTION("sums its values") {
+    REQUIRE(Generics::Reduce(tree, 0L, std::plus<>{}, Generics::Identity{}, pool) == 5000050000L);
+    REQUIRE(Generics::Reduce(tree, 0L, std::plus<>{}) == 5000050000L);
+  }
+
+  SECTION("keeps the order for combinations that do not commute") {
+    const auto digits = Generics::Reduce(tree, std::string{},
+        [](std::string lhs, std::string const& rhs) { return lhs + rhs; },
+        [](long value) { return std::to_string(value % 10); },
+        pool
+    );
+    std::string expected;
+    for (const auto value : values) {
+      expected += std::to_string(value % 10);
+    }
+    REQUIRE(digits == expected);
+  }
+
+  SECTION("of an empty tree gives the identity") {
+    REQUIRE(Generics::Reduce(Generics::Tree<long>{}, 7L, std::plus<>{}, Generics::Identity{}, pool) == 7);
+  }
+}
+
+
+TEST_CASE("Counting and visiting the values of a tree in parallel") {
+  Generics::ThreadPool pool{4};
+  std::vector<int> values(100000);
+  std::iota(values.begin(), values.end(), 0);
+  const Generics::Tree<int> tree{values.begin(), values.end()};
+
+  REQUIRE(Generics::CountIf(tree, [](int value) { return value % 3 == 0; }, pool) == 33334);
+
+  std::vector<std::atomic<int>> visits(values.size());
+  Generics::ForEach(tree, [&visits](int value) { ++visits[value]; }, pool);
+  REQUIRE(std::all_of(visits.begin(), visits.end(), [](auto const& count) { return count == 1; }));
+}
+
+
+TEST_CASE("Benchmark reducing a tree on more threads", "![benchmark]") {
+  static constexpr long Count{10000000};
+  std::vector<long> values(Count);
+  std::iota(values.begin(), values.end(), 0);
+  const Generics::Tree<long> tree{values.begin(), values.end()};
+  const auto expected = Count * (Count - 1) / 2;
+
+  BENCHMARK("Sequential range-for over 10M values") {
+    long sum{0};
+    for (const auto value : tree) {
+      sum += value;
+    }
+    REQUIRE(sum == expected);
+  }
+
+  const auto hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1;; threads = std::min(threads * 2, hardware_threads)) {
+    Generics::ThreadPool pool{threads};
+    const auto name = "Reduce over 10M values on " + std::to_string(threads) + " threads";
+    BENCHMARK(name.c_str()) {
+      REQUIRE(Generics::Reduce(tree, 0L, std::plus<>{}, Generics::Identity{}, pool) == expected);
+    }
+    const auto count_name = "CountIf over 10M values on " + std::to_string(threads) + " threads";
+    BENCHMARK(count_name.c_str()) {
+      REQUIRE(Generics::CountIf(tree, [](long value) { return value % 7 == 0; }, pool) == (Count + 6) / 7);
+    }
+    if (threads == hardware_threads) {
+      break;
+    }
+  }
+}
@@ -0,0 +1,193 @@
+#include "catch2/catch.hpp"
+
+#include "Generics/SetOperations.h"
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace {
+  using TreeOfIntegers = Generics::Tree<int>;
+
+  // Whether no red node has a red child and all paths hold as many black
+  // nodes as the root caches.
+  template<class TreeType>
+    bool IsRedBlack(TreeType const& tree, std::size_t black_height) {
+      if (tree.empty()) {
+        return black_height == 0;
+      }
+      const auto red = tree.colour() == Generics::Colour::Red;
+      if (red && ((!tree.left().empty() && tree.left().colour() == Generics::Colour::Red)
+          || (!tree.right().empty() && tree.right().colour() == Generics::Colour::Red))) {
+        return false;
+      }
+      const auto below = black_height - (red ? 0 : 1);
+      return tree.black_height() == black_height
+          && IsRedBlack(tree.left(), below)
+          && IsRedBlack(tree.right(), below)
+      ;
+    }
+
+  template<class TreeType>
+    bool IsRedBlack(TreeType const& tree) {
+      return IsRedBlack(tree, tree.black_height());
+    }
+
+
+  std::set<int> RandomSet(std::mt19937& generator, std::size_t count, int max) {
+    std::uniform_int_distribution<int> value(0, max);
+    std::set<int> result;
+    while (result.size() < count) {
+      result.insert(value(generator));
+    }
+    return result;
+  }
+} // anonymous namespace
+
+
+TEST_CASE("Set operations on trees") {
+  std::mt19937 generator{19};
+  for (auto const& [lhs_count, rhs_count] : {
+      std::pair{0, 0}, std::pair{0, 10}, std::pair{10, 0}, std::pair{1, 500},
+      std::pair{500, 1}, std::pair{300, 300}, std::pair{2000, 50}
+  }) {
+    const auto lhs_values = RandomSet(generator, lhs_count, 3000);
+    const auto rhs_values = RandomSet(generator, rhs_count, 3000);
+    const TreeOfIntegers lhs{lhs_values.begin(), lhs_values.end()};
+    const TreeOfIntegers rhs{rhs_values.begin(), rhs_values.end()};
+
+    std::vector<int> expected;
+    const auto require_expected = [&expected](TreeOfIntegers const& result) {
+      REQUIRE(IsRedBlack(result));
+      REQUIRE(std::equal(result.begin(), result.end(), expected.begin(), expected.end()));
+      expected.clear();
+    };
+
+    std::set_union(
+        lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(),
+        std::back_inserter(expected)
+    );
+    require_expected(Generics::Union(lhs, rhs));
+
+    std::set_intersection(
+        lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(),
+        std::back_inserter(expected)
+    );
+    require_expected(Generics::Intersection(lhs, rhs));
+
+    std::set_difference(
+        lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(),
+        std::back_inserter(expected)
+    );
+    require_expected(Generics::Difference(lhs, rhs));
+  }
+}
+
+
+TEST_CASE("Set operations reuse what the trees share") {
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  const TreeOfIntegers tree{values.begin(), values.end()};
+
+  SECTION("the same tree") {
+    REQUIRE(Generics::Union(tree, tree) == tree);
+    REQUIRE(Generics::Intersection(tree, tree) == tree);
+    REQUIRE(Generics::Difference(tree, tree).empty());
+  }
+
+  SECTION("an empty tree") {
+    REQUIRE(Generics::Union(tree, TreeOfIntegers{}) == tree);
+    REQUIRE(Generics::Union(TreeOfIntegers{}, tree) == tree);
+    REQUIRE(Generics::Difference(tree, TreeOfIntegers{}) == tree);
+    REQUIRE(Generics::Intersection(tree, TreeOfIntegers{}).empty());
+  }
+
+  SECTION("a subset of the tree") {
+    const auto smaller = Generics::Removed(Generics::Removed(tree, 10), 700);
+    REQUIRE(Generics::Union(tree, smaller) == tree);
+    REQUIRE(Generics::Intersection(tree, smaller) != tree);
+    REQUIRE(Generics::Difference(smaller, tree).empty());
+
+    const auto removed = Generics::Difference(tree, smaller);
+    REQUIRE(std::vector<int>(removed.begin(), removed.end()) == std::vector<int>{10, 700});
+  }
+
+  SECTION("values the other tree lacks") {
+    TreeOfIntegers other{-1, 2000};
+    REQUIRE(Generics::Difference(tree, other) == tree);
+  }
+}
+
+
+TEST_CASE("Set operations on large trees in parallel") {
+  std::mt19937 generator{19};
+  const auto lhs_values = RandomSet(generator, 100000, 1000000);
+  const auto rhs_values = RandomSet(generator, 60000, 1000000);
+  const TreeOfIntegers lhs{lhs_values.begin(), lhs_values.end()};
+  const TreeOfIntegers rhs{rhs_values.begin(), rhs_values.end()};
+
+  const auto united = Generics::Union(lhs, rhs, Generics::Execution::Parallel);
+  REQUIRE(IsRedBlack(united));
+  const auto sequential_union = Generics::Union(lhs, rhs);
+  REQUIRE(std::equal(
+      united.begin(), united.end(),
+      sequential_union.begin(), sequential_union.end()
+  ));
+
+  const auto intersection = Generics::Intersection(lhs, rhs, Generics::Execution::Parallel);
+  REQUIRE(IsRedBlack(intersection));
+  const auto sequential_intersection = Generics::Intersection(lhs, rhs);
+  REQUIRE(std::equal(
+      intersection.begin(), intersection.end(),
+      sequential_intersection.begin(), sequential_intersection.end()
+  ));
+
+  const auto difference = Generics::Difference(lhs, rhs, Generics::Execution::Parallel);
+  REQUIRE(IsRedBlack(difference));
+  const auto sequential_difference = Generics::Difference(lhs, rhs);
+  REQUIRE(std::equal(
+      difference.begin(), difference.end(),
+      sequential_difference.begin(), sequential_difference.end()
+  ));
+}
+
+
+TEST_CASE("Benchmark set operations", "![benchmark]") {
+  std::mt19937 generator{19};
+  const auto lhs_values = RandomSet(generator, 1000000, 100000000);
+  const auto rhs_values = RandomSet(generator, 1000000, 100000000);
+  const TreeOfIntegers lhs{lhs_values.begin(), lhs_values.end()};
+  const TreeOfIntegers rhs{rhs_values.begin(), rhs_values.end()};
+  const std::vector<int> sorted(lhs_values.begin(), lhs_values.end());
+
+  BENCHMARK("Tree, building from 1M sorted values") {
+    const TreeOfIntegers tree{sorted.begin(), sorted.end()};
+  }
+  BENCHMARK("Tree, inserting 1M sorted values") {
+    TreeOfIntegers tree;
+    for (const auto v : sorted) {
+      tree = Generics::Inserted(tree, v);
+    }
+  }
+  BENCHMARK("Tree, union of 1M and 1M values") {
+    const auto united = Generics::Union(lhs, rhs);
+  }
+  BENCHMARK("Tree, union of 1M and 1M values in parallel") {
+    const auto united = Generics::Union(lhs, rhs, Generics::Execution::Parallel);
+  }
+  BENCHMARK("std::set_union of 1M and 1M values") {
+    std::set<int> united;
+    std::set_union(
+        lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(),
+        std::inserter(united, united.end())
+    );
+  }
+
+  const auto changed = Generics::Inserted(Generics::Removed(lhs, *lhs_values.begin()), -1);
+  BENCHMARK("Tree, union of two versions of a 1M tree") {
+    const auto united = Generics::Union(lhs, changed);
+  }
+}
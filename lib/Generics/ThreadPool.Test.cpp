@@ -0,0 +1,73 @@
+#include "catch2/catch.hpp"
+
+#include "Generics/ThreadPool.h"
+#include <atomic>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+  long Fibonacci(Generics::ThreadPool& pool, int n) {
+    if (n < 15) {
+      return n < 2 ? n : Fibonacci(pool, n - 1) + Fibonacci(pool, n - 2);
+    }
+    const auto [lhs, rhs] = pool.both(
+        [&pool, n]() { return Fibonacci(pool, n - 1); },
+        [&pool, n]() { return Fibonacci(pool, n - 2); }
+    );
+    return lhs + rhs;
+  }
+} // anonymous namespace
+
+
+TEST_CASE("A thread pool runs tasks") {
+  Generics::ThreadPool pool{4};
+  REQUIRE(pool.size() == 4);
+
+  SECTION("handed in from outside") {
+    REQUIRE(pool.run([]() { return 42; }) == 42);
+    REQUIRE(pool.run([]() { return std::this_thread::get_id(); }) != std::this_thread::get_id());
+  }
+
+  SECTION("forking and joining recursively") {
+    REQUIRE(Fibonacci(pool, 27) == 196418);
+  }
+
+  SECTION("on more than one thread") {
+    std::atomic<int> running{0};
+    std::atomic<bool> met{false};
+    // Each half waits a little for the other one to start.
+    const auto half = [&running, &met]() {
+      ++running;
+      for (int i = 0; i < 1000 && running < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      met = met || running == 2;
+      return 0;
+    };
+    pool.both(half, half);
+    REQUIRE(met);
+  }
+
+  SECTION("passing on what they throw") {
+    REQUIRE_THROWS_AS(
+        pool.run([]() -> int { throw std::runtime_error{"task"}; }),
+        std::runtime_error
+    );
+    REQUIRE_THROWS_AS(
+        pool.both([]() -> int { throw std::runtime_error{"left"}; }, []() { return 1; }),
+        std::runtime_error
+    );
+    REQUIRE_THROWS_AS(
+        pool.both([]() { return 1; }, []() -> int { throw std::runtime_error{"right"}; }),
+        std::runtime_error
+    );
+    REQUIRE(pool.run([]() { return 1; }) == 1);
+  }
+}
+
+
+TEST_CASE("A thread pool with a single thread still forks and joins") {
+  Generics::ThreadPool pool{1};
+  REQUIRE(Fibonacci(pool, 22) == 17711);
+}
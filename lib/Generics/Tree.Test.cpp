@@ -1,6 +1,37 @@
 #include "catch2/catch.hpp"
 
 #include "Generics/Tree.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace {
+  // The black height of a valid red-black tree, or -1 when a red node has a
+  // red child, two paths differ in black nodes or a node caches a wrong one.
+  template<class T>
+    int BlackHeightOf(Generics::Tree<T> const& tree) {
+      if (tree.empty()) {
+        return 0;
+      }
+      const auto red = tree.colour() == Generics::Colour::Red;
+      if (red && ((!tree.left().empty() && tree.left().colour() == Generics::Colour::Red)
+          || (!tree.right().empty() && tree.right().colour() == Generics::Colour::Red))) {
+        return -1;
+      }
+      const auto left = BlackHeightOf(tree.left());
+      const auto right = BlackHeightOf(tree.right());
+      if (left < 0 || left != right) {
+        return -1;
+      }
+      const auto height = left + (red ? 0 : 1);
+      return static_cast<int>(tree.black_height()) == height ? height : -1;
+    }
+} // anonymous namespace
 
 TEST_CASE("Simple binary search tree") {
   using TreeOfIntegers = Generics::Tree<int>;
@@ -22,6 +53,78 @@ TEST_CASE("Binary tree can be constructed from any sequence") {
 }
 
 
+TEST_CASE("Building a tree from a sequence") {
+  using TreeOfIntegers = Generics::Tree<int>;
+  SECTION("of sorted values of any count") {
+    for (int count = 0; count < 300; ++count) {
+      std::vector<int> sorted(count);
+      std::iota(sorted.begin(), sorted.end(), 0);
+      const TreeOfIntegers tree{sorted.begin(), sorted.end()};
+      REQUIRE(BlackHeightOf(tree) >= 0);
+      REQUIRE(std::equal(tree.begin(), tree.end(), sorted.begin(), sorted.end()));
+    }
+  }
+
+  SECTION("of values in any order with repetitions") {
+    std::mt19937 generator{19};
+    std::uniform_int_distribution<int> value(0, 500);
+    std::vector<int> values(1000);
+    std::generate(values.begin(), values.end(), [&]() { return value(generator); });
+    const std::set<int> expected(values.begin(), values.end());
+    const TreeOfIntegers tree{values.begin(), values.end()};
+    REQUIRE(BlackHeightOf(tree) >= 0);
+    REQUIRE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+  }
+}
+
+
+TEST_CASE("Joining and splitting trees") {
+  using TreeOfIntegers = Generics::Tree<int>;
+  std::mt19937 generator{19};
+  const auto tree_of = [](int from, int to) {
+    TreeOfIntegers tree;
+    for (int v = from; v < to; v += 2) {
+      tree = Generics::Inserted(tree, v);
+    }
+    return tree;
+  };
+
+  SECTION("joining trees of any heights") {
+    for (auto const& [left_count, right_count] : {
+        std::pair{0, 0}, std::pair{0, 5}, std::pair{5, 0}, std::pair{1, 1000},
+        std::pair{1000, 1}, std::pair{300, 400}, std::pair{4000, 20}
+    }) {
+      const auto left = tree_of(0, 2 * left_count);
+      const auto right = tree_of(2 * left_count + 2, 2 * (left_count + right_count) + 2);
+      const auto joined = Generics::Joined(left, 2 * left_count, right);
+      REQUIRE(BlackHeightOf(joined) >= 0);
+      std::vector<int> expected(left_count + right_count + 1);
+      std::generate(expected.begin(), expected.end(), [v = 0]() mutable { return (v += 2) - 2; });
+      REQUIRE(std::equal(joined.begin(), joined.end(), expected.begin(), expected.end()));
+
+      const auto concatenated = Generics::Concatenated(left, right);
+      REQUIRE(BlackHeightOf(concatenated) >= 0);
+      expected.erase(expected.begin() + left_count);
+      REQUIRE(std::equal(concatenated.begin(), concatenated.end(), expected.begin(), expected.end()));
+    }
+  }
+
+  SECTION("splitting at values there or not") {
+    const auto tree = tree_of(0, 4000);
+    std::uniform_int_distribution<int> value(-10, 4010);
+    for (int i = 0; i < 200; ++i) {
+      const auto at = value(generator);
+      const auto parts = Generics::SplitAt(tree, at);
+      REQUIRE(parts.found == Generics::Has(tree, at));
+      REQUIRE(BlackHeightOf(parts.less) >= 0);
+      REQUIRE(BlackHeightOf(parts.greater) >= 0);
+      REQUIRE(std::equal(parts.less.begin(), parts.less.end(), tree.begin(), tree.lower_bound(at)));
+      REQUIRE(std::equal(parts.greater.begin(), parts.greater.end(), tree.upper_bound(at), tree.end()));
+    }
+  }
+}
+
+
 TEST_CASE("The height of a tree") {
   using TreeOfIntegers = Generics::Tree<int>;
   TreeOfIntegers empty_tree;
@@ -39,8 +142,197 @@ TEST_CASE("The height of a tree") {
     const TreeOfIntegers tree_of_single_element{
       consecutively_less_elements.begin(), consecutively_less_elements.end()
     };
-    REQUIRE(HeightOf(tree_of_single_element) == consecutively_less_elements.size());
+    REQUIRE(HeightOf(tree_of_single_element) == 2);
+  }
+
+  SECTION("sorted input stays logarithmic") {
+    std::vector<int> sorted(100000);
+    std::iota(sorted.begin(), sorted.end(), 0);
+    const TreeOfIntegers tree{sorted.begin(), sorted.end()};
+    REQUIRE(HeightOf(tree) <= 2 * 17);
+    REQUIRE(BlackHeightOf(tree) > 0);
+  }
+}
+
+
+TEST_CASE("Trees stay balanced through random insertions and removals") {
+  using TreeOfIntegers = Generics::Tree<int>;
+  std::mt19937 generator{16};
+  std::uniform_int_distribution<int> value(0, 2000);
+  TreeOfIntegers tree;
+  std::set<int> expected;
+  for (int i = 0; i < 20000; ++i) {
+    const auto v = value(generator);
+    if (i % 3 == 2) {
+      tree = Generics::Removed(tree, v);
+      expected.erase(v);
+    }
+    else {
+      tree = Generics::Inserted(tree, v);
+      expected.insert(v);
+    }
+    if (i % 100 == 0) {
+      REQUIRE(BlackHeightOf(tree) >= 0);
+      REQUIRE(tree.colour() == Generics::Colour::Black);
+    }
+  }
+  REQUIRE(BlackHeightOf(tree) >= 0);
+  REQUIRE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+
+  SECTION("down to the empty tree") {
+    for (const auto v : expected) {
+      tree = Generics::Removed(tree, v);
+      REQUIRE(BlackHeightOf(tree) >= 0);
+    }
+    REQUIRE(tree.empty());
+  }
+}
+
+
+namespace {
+  struct Counted {
+    static int instances;
+    int value;
+
+    Counted(int v) : value{v} { ++instances; }
+    Counted(Counted const& other) : value{other.value} { ++instances; }
+    ~Counted() { --instances; }
+
+    bool operator<(Counted const& rhs) const { return value < rhs.value; }
+  };
+  int Counted::instances{0};
+} // anonymous namespace
+
+
+namespace {
+  struct SumOfValues {
+    using Type = long;
+
+    static Type Identity() noexcept { return 0; }
+    static Type Of(int value) noexcept { return value; }
+    static Type Combined(Type lhs, Type rhs) noexcept { return lhs + rhs; }
+  };
+
+  using SummedTree = Generics::Tree<int, std::less<int>, Generics::AtomicRefCount, SumOfValues>;
+
+  // Whether every node caches the size, height and sum of its subtree.
+  bool IsCounted(SummedTree const& tree) {
+    if (tree.empty()) {
+      return true;
+    }
+    auto const& left = tree.left();
+    auto const& right = tree.right();
+    return tree.size() == left.size() + 1 + right.size()
+        && tree.height() == std::max(left.height(), right.height()) + 1
+        && tree.measure() == left.measure() + tree.root() + right.measure()
+        && IsCounted(left)
+        && IsCounted(right)
+    ;
+  }
+} // anonymous namespace
+
+
+TEST_CASE("Trees keep the size and measure of their subtrees") {
+  std::mt19937 generator{24};
+  std::uniform_int_distribution<int> value(0, 2000);
+  SummedTree tree;
+  std::set<int> expected;
+  for (int i = 0; i < 5000; ++i) {
+    const auto v = value(generator);
+    if (i % 3 == 2) {
+      tree = Generics::Removed(tree, v);
+      expected.erase(v);
+    }
+    else {
+      tree = Generics::Inserted(tree, v);
+      expected.insert(v);
+    }
+  }
+  REQUIRE(IsCounted(tree));
+  const std::vector<int> values(expected.begin(), expected.end());
+  REQUIRE(Generics::Size(tree) == values.size());
+  REQUIRE(tree.measure() == std::accumulate(values.begin(), values.end(), 0L));
+
+  SECTION("ranking and selecting values") {
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      REQUIRE(*Generics::Select(tree, i) == values[i]);
+      REQUIRE(Generics::Rank(tree, values[i]) == i);
+    }
+    REQUIRE(Generics::Select(tree, values.size()) == nullptr);
+    REQUIRE(Generics::Rank(tree, -1) == 0);
+    REQUIRE(Generics::Rank(tree, 3000) == values.size());
   }
+
+  SECTION("measuring ranges of values") {
+    for (int i = 0; i < 200; ++i) {
+      auto lower = value(generator);
+      auto upper = value(generator);
+      if (upper < lower) {
+        std::swap(lower, upper);
+      }
+      const auto first = std::lower_bound(values.begin(), values.end(), lower);
+      const auto last = std::lower_bound(values.begin(), values.end(), upper);
+      REQUIRE(Generics::MeasureBefore(tree, upper) == std::accumulate(values.begin(), last, 0L));
+      REQUIRE(Generics::MeasureFrom(tree, lower) == std::accumulate(first, values.end(), 0L));
+      REQUIRE(Generics::MeasureBetween(tree, lower, upper) == std::accumulate(first, last, 0L));
+    }
+    REQUIRE(Generics::MeasureBetween(tree, 10, 10) == 0);
+    REQUIRE(Generics::MeasureBetween(SummedTree{}, 0, 10) == 0);
+  }
+
+  SECTION("through joining, splitting and building") {
+    const auto parts = Generics::SplitAt(tree, 1000);
+    REQUIRE(IsCounted(parts.less));
+    REQUIRE(IsCounted(parts.greater));
+    REQUIRE(Generics::Size(parts.less) == Generics::Rank(tree, 1000));
+    const auto rejoined = Generics::Concatenated(parts.less, parts.greater);
+    REQUIRE(IsCounted(rejoined));
+    REQUIRE(rejoined.measure() == tree.measure() - (parts.found ? 1000 : 0));
+
+    const SummedTree built{values.begin(), values.end()};
+    REQUIRE(IsCounted(built));
+    REQUIRE(built.measure() == tree.measure());
+  }
+}
+
+
+TEST_CASE("Trees release their nodes") {
+  SECTION("with atomic reference counts") {
+    {
+      Generics::Tree<Counted> tree;
+      for (int i = 0; i < 1000; ++i) {
+        tree = Generics::Inserted(tree, Counted{i});
+      }
+      const auto smaller = Generics::Removed(tree, Counted{500});
+      REQUIRE(Counted::instances >= 1000);
+    }
+    REQUIRE(Counted::instances == 0);
+  }
+
+  SECTION("with plain reference counts") {
+    {
+      Generics::Tree<Counted, std::less<Counted>, Generics::LocalRefCount> tree;
+      for (int i = 0; i < 1000; ++i) {
+        tree = Generics::Inserted(tree, Counted{i});
+      }
+      REQUIRE(Generics::Has(tree, Counted{999}));
+      tree = Generics::Removed(tree, Counted{999});
+      REQUIRE(!Generics::Has(tree, Counted{999}));
+    }
+    REQUIRE(Counted::instances == 0);
+  }
+}
+
+
+TEST_CASE("Unchanged trees are the same tree") {
+  using TreeOfIntegers = Generics::Tree<int>;
+  const TreeOfIntegers tree{5, 3, 8, 1, 4};
+  REQUIRE(Generics::Inserted(tree, 4) == tree);
+  REQUIRE(Generics::Removed(tree, 7) == tree);
+
+  const auto bigger = Generics::Inserted(tree, 9);
+  REQUIRE(bigger != tree);
+  REQUIRE(bigger.left() == tree.left());
 }
 
 
@@ -62,6 +354,126 @@ TEST_CASE("Trees can be iterated through inorder traversal") {
 }
 
 
+TEST_CASE("Iterating a tree in both directions") {
+  using TreeOfIntegers = Generics::Tree<int>;
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  std::shuffle(values.begin(), values.end(), std::mt19937{18});
+  const TreeOfIntegers tree{values.begin(), values.end()};
+  std::sort(values.begin(), values.end());
+
+  SECTION("forwards and backwards visits every value once") {
+    REQUIRE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+    REQUIRE(std::equal(tree.rbegin(), tree.rend(), values.rbegin(), values.rend()));
+    REQUIRE(std::distance(tree.begin(), tree.end()) == 1000);
+  }
+
+  SECTION("steps back from the end to the last value") {
+    auto last = tree.end();
+    --last;
+    REQUIRE(*last == 999);
+    REQUIRE(*std::prev(last, 999) == 0);
+    REQUIRE(std::next(std::prev(last, 999), 999) == last);
+  }
+
+  SECTION("of an empty tree ends right away") {
+    const TreeOfIntegers empty;
+    REQUIRE(empty.begin() == empty.end());
+    REQUIRE(empty.rbegin() == empty.rend());
+  }
+}
+
+
+TEST_CASE("Seeking the bounds of a value") {
+  using TreeOfIntegers = Generics::Tree<int>;
+  const TreeOfIntegers evens{0, 2, 4, 6, 8, 10, 12, 14, 16, 18};
+
+  REQUIRE(*evens.lower_bound(4) == 4);
+  REQUIRE(*evens.upper_bound(4) == 6);
+  REQUIRE(*evens.lower_bound(5) == 6);
+  REQUIRE(*evens.upper_bound(5) == 6);
+  REQUIRE(*evens.lower_bound(-1) == 0);
+  REQUIRE(evens.lower_bound(19) == evens.end());
+  REQUIRE(evens.upper_bound(18) == evens.end());
+
+  SECTION("gives iterators that step on in both directions") {
+    auto it = evens.lower_bound(7);
+    REQUIRE(*++it == 10);
+    REQUIRE(*--it == 8);
+    REQUIRE(*--it == 6);
+    REQUIRE(std::distance(evens.lower_bound(6), evens.upper_bound(12)) == 4);
+  }
+}
+
+
+TEST_CASE("Trees order values by their comparator") {
+  const Generics::Tree<int, std::greater<int>> descending{3, 1, 4, 1, 5, 9, 2, 6};
+  REQUIRE(std::vector<int>(descending.begin(), descending.end()) == std::vector<int>{9, 6, 5, 4, 3, 2, 1});
+  REQUIRE(Generics::Has(descending, 4));
+  REQUIRE(*descending.lower_bound(7) == 6);
+
+  const auto changed = Generics::Removed(Generics::Inserted(descending, 7), 9);
+  REQUIRE(std::vector<int>(changed.begin(), changed.end()) == std::vector<int>{7, 6, 5, 4, 3, 2, 1});
+}
+
+
+namespace {
+  // Compares Counted values with plain integers too.
+  struct CountedCompare {
+    using is_transparent = void;
+
+    static int ValueOf(Counted const& counted) { return counted.value; }
+    static int ValueOf(int value) { return value; }
+
+    template<class Lhs, class Rhs>
+      bool operator()(Lhs const& lhs, Rhs const& rhs) const {
+        return ValueOf(lhs) < ValueOf(rhs);
+      }
+  };
+} // anonymous namespace
+
+
+TEST_CASE("Looking up keys of another type copies no values") {
+  {
+    Generics::Tree<Counted, CountedCompare> tree;
+    for (int i = 0; i < 1000; i += 2) {
+      tree = Generics::Inserted(tree, Counted{i});
+    }
+    const auto instances = Counted::instances;
+
+    REQUIRE(Generics::Has(tree, 500));
+    REQUIRE(!Generics::Has(tree, 501));
+    REQUIRE(Generics::Find(tree, 42)->value == 42);
+    REQUIRE(Generics::Find(tree, 43) == nullptr);
+    REQUIRE(tree.lower_bound(43)->value == 44);
+    REQUIRE(tree.upper_bound(44)->value == 46);
+    REQUIRE(&tree.left().root() == &tree.node()->left.root());
+    REQUIRE(Counted::instances == instances);
+
+    tree = Generics::Removed(tree, 500);
+    REQUIRE(!Generics::Has(tree, 500));
+    REQUIRE(Generics::Removed(tree, 501) == tree);
+  }
+  REQUIRE(Counted::instances == 0);
+}
+
+
+TEST_CASE("Assigning replaces an equal value") {
+  Generics::Tree<Counted, CountedCompare> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree = Generics::Inserted(tree, Counted{i});
+  }
+  auto const* before = Generics::Find(tree, 50);
+  REQUIRE(Generics::Inserted(tree, Counted{50}) == tree);
+
+  const auto assigned = Generics::Assigned(tree, Counted{50});
+  REQUIRE(assigned != tree);
+  REQUIRE(Generics::Find(assigned, 50) != before);
+  REQUIRE(Generics::Find(tree, 50) == before);
+  REQUIRE(std::distance(assigned.begin(), assigned.end()) == 100);
+}
+
+
 TEST_CASE("Trees can be created from a Tree by removing an element") {
   using Tree = Generics::Tree<int>;
 
@@ -75,4 +487,84 @@ TEST_CASE("Trees can be created from a Tree by removing an element") {
     const auto reduced{Generics::Removed(numbers, ArbitraryElement)};
     REQUIRE(!Generics::Has(reduced, ArbitraryElement));
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Benchmark tree insertion against std::set", "![benchmark]") {
+  static constexpr int Count{100000};
+  std::vector<int> sorted(Count);
+  std::iota(sorted.begin(), sorted.end(), 0);
+  auto shuffled = sorted;
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{16});
+
+  BENCHMARK("Tree, sorted inserts") {
+    Generics::Tree<int> tree;
+    for (const auto v : sorted) {
+      tree = Generics::Inserted(tree, v);
+    }
+  }
+  BENCHMARK("Tree with plain reference counts, sorted inserts") {
+    Generics::Tree<int, std::less<int>, Generics::LocalRefCount> tree;
+    for (const auto v : sorted) {
+      tree = Generics::Inserted(tree, v);
+    }
+  }
+  BENCHMARK("std::set, sorted inserts") {
+    std::set<int> set;
+    for (const auto v : sorted) {
+      set.insert(v);
+    }
+  }
+  BENCHMARK("Tree, random inserts") {
+    Generics::Tree<int> tree;
+    for (const auto v : shuffled) {
+      tree = Generics::Inserted(tree, v);
+    }
+  }
+  BENCHMARK("std::set, random inserts") {
+    std::set<int> set;
+    for (const auto v : shuffled) {
+      set.insert(v);
+    }
+  }
+
+  const Generics::Tree<int> tree{shuffled.begin(), shuffled.end()};
+  const std::set<int> set{shuffled.begin(), shuffled.end()};
+  BENCHMARK("Tree, lookups") {
+    int found{0};
+    for (const auto v : shuffled) {
+      found += Generics::Has(tree, v) ? 1 : 0;
+    }
+    REQUIRE(found == Count);
+  }
+  BENCHMARK("std::set, lookups") {
+    int found{0};
+    for (const auto v : shuffled) {
+      found += set.count(v) ? 1 : 0;
+    }
+    REQUIRE(found == Count);
+  }
+}
+
+
+TEST_CASE("Benchmark iterating a tree against std::set", "![benchmark]") {
+  std::vector<int> values(1000000);
+  std::iota(values.begin(), values.end(), 0);
+  std::shuffle(values.begin(), values.end(), std::mt19937{18});
+  const Generics::Tree<int> tree{values.begin(), values.end()};
+  const std::set<int> set{values.begin(), values.end()};
+
+  BENCHMARK("Tree, range-for over 1M values") {
+    long sum{0};
+    for (const auto v : tree) {
+      sum += v;
+    }
+    REQUIRE(sum == 499999500000);
+  }
+  BENCHMARK("std::set, range-for over 1M values") {
+    long sum{0};
+    for (const auto v : set) {
+      sum += v;
+    }
+    REQUIRE(sum == 499999500000);
+  }
+}
@@ -0,0 +1,250 @@
+#include "catch2/catch.hpp"
+
+#include "Generics/TreeBuilder.h"
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace {
+  // Whether no red node has a red child and all paths hold as many black
+  // nodes as the root caches.
+  template<class TreeType>
+    bool IsRedBlack(TreeType const& tree, std::size_t black_height) {
+      if (tree.empty()) {
+        return black_height == 0;
+      }
+      const auto red = tree.colour() == Generics::Colour::Red;
+      if (red && ((!tree.left().empty() && tree.left().colour() == Generics::Colour::Red)
+          || (!tree.right().empty() && tree.right().colour() == Generics::Colour::Red))) {
+        return false;
+      }
+      const auto below = black_height - (red ? 0 : 1);
+      return tree.black_height() == black_height
+          && IsRedBlack(tree.left(), below)
+          && IsRedBlack(tree.right(), below)
+      ;
+    }
+
+  template<class TreeType>
+    bool IsRedBlack(TreeType const& tree) {
+      return IsRedBlack(tree, tree.black_height());
+    }
+
+
+  struct SumOfValues {
+    using Type = long;
+
+    static Type Identity() noexcept { return 0; }
+    static Type Of(int value) noexcept { return value; }
+    static Type Combined(Type lhs, Type rhs) noexcept { return lhs + rhs; }
+  };
+
+  // Whether every node caches the size, height and sum of its subtree.
+  template<class TreeType>
+    bool IsCounted(TreeType const& tree) {
+      if (tree.empty()) {
+        return true;
+      }
+      auto const& left = tree.left();
+      auto const& right = tree.right();
+      return tree.size() == left.size() + 1 + right.size()
+          && tree.height() == std::max(left.height(), right.height()) + 1
+          && tree.measure() == left.measure() + tree.root() + right.measure()
+          && IsCounted(left)
+          && IsCounted(right)
+      ;
+    }
+
+
+  struct Counted {
+    static int instances;
+    int value;
+
+    Counted(int v) : value{v} { ++instances; }
+    Counted(Counted const& other) : value{other.value} { ++instances; }
+    Counted& operator=(Counted const& other) = default;
+    ~Counted() { --instances; }
+
+    bool operator<(Counted const& rhs) const { return value < rhs.value; }
+  };
+  int Counted::instances{0};
+} // anonymous namespace
+
+
+TEST_CASE("Building a tree through random insertions and removals") {
+  std::mt19937 generator{20};
+  std::uniform_int_distribution<int> value(0, 3000);
+  Generics::TreeBuilder<int> builder;
+  std::set<int> expected;
+
+  // Trees taken along the way, with what they held then.
+  std::vector<std::pair<Generics::Tree<int>, std::vector<int>>> versions;
+  for (int i = 0; i < 30000; ++i) {
+    const auto v = value(generator);
+    if (i % 3 == 2) {
+      builder.remove(v);
+      expected.erase(v);
+    }
+    else {
+      builder.insert(v);
+      expected.insert(v);
+    }
+    if (i % 1000 == 0) {
+      const auto tree = builder.tree();
+      REQUIRE(IsRedBlack(tree));
+      REQUIRE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+      versions.emplace_back(tree, std::vector<int>(expected.begin(), expected.end()));
+    }
+  }
+
+  for (auto const& [tree, values] : versions) {
+    REQUIRE(IsRedBlack(tree));
+    REQUIRE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+  }
+
+  SECTION("down to the empty tree") {
+    for (const auto v : expected) {
+      builder.remove(v);
+      REQUIRE(!builder.has(v));
+    }
+    REQUIRE(builder.empty());
+    REQUIRE(builder.tree().empty());
+  }
+}
+
+
+TEST_CASE("Builders keep the size and measure of every subtree") {
+  using Builder = Generics::TreeBuilder<int, std::less<int>, Generics::AtomicRefCount, SumOfValues>;
+  std::mt19937 generator{24};
+  std::uniform_int_distribution<int> value(0, 2000);
+  Builder builder;
+  std::set<int> expected;
+  for (int i = 0; i < 20000; ++i) {
+    const auto v = value(generator);
+    if (i % 3 == 2) {
+      builder.remove(v);
+      expected.erase(v);
+    }
+    else {
+      builder.insert(v);
+      expected.insert(v);
+    }
+    if (i % 500 == 0) {
+      REQUIRE(IsRedBlack(builder.tree()));
+      REQUIRE(IsCounted(builder.tree()));
+    }
+  }
+  REQUIRE(builder.tree().size() == expected.size());
+  REQUIRE(builder.tree().measure() == std::accumulate(expected.begin(), expected.end(), 0L));
+
+  SECTION("down to the empty tree") {
+    for (const auto v : expected) {
+      builder.remove(v);
+      REQUIRE(IsCounted(builder.tree()));
+    }
+    REQUIRE(builder.tree().measure() == 0);
+  }
+}
+
+
+TEST_CASE("Building on an existing tree") {
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  const Generics::Tree<int> tree{values.begin(), values.end()};
+
+  Generics::TreeBuilder<int> builder{tree};
+  REQUIRE(builder.tree() == tree);
+  for (int v = 0; v < 1000; v += 2) {
+    builder.remove(v);
+  }
+  builder.insert(-1);
+
+  REQUIRE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+  REQUIRE(IsRedBlack(tree));
+  const auto built = builder.tree();
+  REQUIRE(IsRedBlack(built));
+  REQUIRE(std::distance(built.begin(), built.end()) == 501);
+  REQUIRE(*built.begin() == -1);
+}
+
+
+TEST_CASE("Trees taken from a builder stay as they were") {
+  Generics::TreeBuilder<int> builder;
+  for (int v = 0; v < 100; ++v) {
+    builder.insert(v);
+  }
+  auto const& kept = builder.tree();
+  for (int v = 100; v < 200; ++v) {
+    builder.insert(v);
+  }
+  for (int v = 0; v < 100; v += 2) {
+    builder.remove(v);
+  }
+
+  std::vector<int> values(100);
+  std::iota(values.begin(), values.end(), 0);
+  REQUIRE(std::equal(kept.begin(), kept.end(), values.begin(), values.end()));
+  REQUIRE(IsRedBlack(kept));
+}
+
+
+TEST_CASE("Builders release their nodes") {
+  {
+    Generics::TreeBuilder<Counted, std::less<Counted>, Generics::LocalRefCount> builder;
+    for (int i = 0; i < 1000; ++i) {
+      builder.insert(Counted{i});
+    }
+    const auto tree = builder.tree();
+    for (int i = 0; i < 1000; i += 3) {
+      builder.remove(Counted{i});
+    }
+    REQUIRE(Counted::instances >= 1000);
+  }
+  REQUIRE(Counted::instances == 0);
+}
+
+
+TEST_CASE("Benchmark building a tree", "![benchmark]") {
+  static constexpr int Count{100000};
+  std::vector<int> shuffled(Count);
+  std::iota(shuffled.begin(), shuffled.end(), 0);
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{20});
+
+  BENCHMARK("Tree, random inserts") {
+    Generics::Tree<int> tree;
+    for (const auto v : shuffled) {
+      tree = Generics::Inserted(tree, v);
+    }
+  }
+  BENCHMARK("TreeBuilder, random inserts") {
+    Generics::TreeBuilder<int> builder;
+    for (const auto v : shuffled) {
+      builder.insert(v);
+    }
+    const auto tree = builder.tree();
+  }
+  BENCHMARK("std::set, random inserts") {
+    std::set<int> set;
+    for (const auto v : shuffled) {
+      set.insert(v);
+    }
+  }
+
+  const Generics::Tree<int> tree{shuffled.begin(), shuffled.end()};
+  BENCHMARK("Tree, removing every value") {
+    auto removed = tree;
+    for (const auto v : shuffled) {
+      removed = Generics::Removed(removed, v);
+    }
+  }
+  BENCHMARK("TreeBuilder, removing every value") {
+    Generics::TreeBuilder<int> builder{tree};
+    for (const auto v : shuffled) {
+      builder.remove(v);
+    }
+  }
+}
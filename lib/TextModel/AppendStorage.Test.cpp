@@ -0,0 +1,49 @@
+#include "catch2/catch.hpp"
+#include "TextModel/AppendStorage.h"
+#include <string>
+
+TEST_CASE("Appending to an append storage", "[unit]") {
+  TextModel::AppendStorage storage;
+  const auto hello = storage.append("Hello");
+  const auto world = storage.append(", World!");
+
+  SECTION("places consecutive texts next to each other") {
+    REQUIRE(hello == 0);
+    REQUIRE(world == 5);
+    REQUIRE(storage.view(0, 13) == "Hello, World!");
+    REQUIRE(storage.size() == 13);
+  }
+
+  SECTION("never moves text already stored") {
+    const auto before = storage.view(hello, 5);
+    for (int i = 0; i < 1000; ++i) {
+      storage.append(std::string(1000, 'x'));
+    }
+    REQUIRE(storage.view(hello, 5).data() == before.data());
+    REQUIRE(before == "Hello");
+  }
+
+  SECTION("starts a new block for text that does not fit") {
+    const std::string filler(TextModel::AppendStorage::BlockSize - 20, '.');
+    storage.append(filler);
+    const auto next = storage.append("does not fit into the rest");
+    REQUIRE(next == TextModel::AppendStorage::BlockSize);
+    REQUIRE(storage.view(next, 26) == "does not fit into the rest");
+  }
+
+  SECTION("does not continue a full block in the next one") {
+    const std::string filler(TextModel::AppendStorage::BlockSize - 13, '.');
+    storage.append(filler);
+    REQUIRE(storage.size() == TextModel::AppendStorage::BlockSize);
+    const auto next = storage.append("next");
+    REQUIRE(next == 2 * TextModel::AppendStorage::BlockSize);
+    REQUIRE(storage.view(next, 4) == "next");
+  }
+
+  SECTION("keeps text larger than a block contiguous") {
+    const std::string large(3 * TextModel::AppendStorage::BlockSize + 7, 'L');
+    const auto start = storage.append(large);
+    REQUIRE(storage.view(start, large.size()) == large);
+    REQUIRE(storage.append("after") == start + large.size());
+  }
+}
@@ -0,0 +1,32 @@
+#include "TextModel/AppendStorage.h"
+#include <algorithm>
+#include <cstring>
+
+namespace TextModel {
+  Index AppendStorage::append(std::string_view text) {
+    if (end_ + text.size() > limit_) {
+      const auto slots = std::max<Index>(1, (text.size() + BlockSize - 1) / BlockSize);
+      const std::shared_ptr<char[]> allocation{new char[slots * BlockSize]};
+      auto blocks = blocks_ ? std::make_shared<Blocks>(*blocks_) : std::make_shared<Blocks>();
+      // A full block would end where the new allocation starts, and a view
+      // running across the two would read past the end of the old one.
+      if (blocks_ && end_ == limit_) {
+        blocks->emplace_back();
+        limit_ += BlockSize;
+      }
+      for (Index slot = 0; slot < slots; ++slot) {
+        blocks->emplace_back(allocation, allocation.get() + slot * BlockSize);
+      }
+      blocks_ = std::move(blocks);
+      end_ = limit_;
+      limit_ += slots * BlockSize;
+    }
+
+    const auto start = end_;
+    if (!text.empty()) {
+      std::memcpy((*blocks_)[start / BlockSize].get() + start % BlockSize, text.data(), text.size());
+    }
+    end_ += text.size();
+    return start;
+  }
+} // TextModel
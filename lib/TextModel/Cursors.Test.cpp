@@ -0,0 +1,93 @@
+#include "catch2/catch.hpp"
+#include "TextModel/Cursors.h"
+#include "TextModel/TextBuffer.h"
+#include <algorithm>
+#include <random>
+
+TEST_CASE("Inserting at several cursors", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"a,b,c"}};
+  const auto cursors = TextModel::InsertAtCursors(buffer, {5, 1, 3, 3}, "\"");
+
+  SECTION("inserts once at every distinct cursor") {
+    REQUIRE(TextModel::FullTextOf(buffer) == "a\",b\",c\"");
+  }
+
+  SECTION("moves the cursors after their insertions") {
+    REQUIRE(cursors == TextModel::Cursors{2, 5, 8});
+  }
+
+  SECTION("is one undo step") {
+    buffer.undo();
+    REQUIRE(TextModel::FullTextOf(buffer) == "a,b,c");
+  }
+}
+
+
+TEST_CASE("Removing at several cursors", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"one,two,three"}};
+
+  SECTION("backspace removes in front of every cursor") {
+    const auto cursors = TextModel::RemoveAtCursors(buffer, {3, 7, 13}, 1, 0);
+    REQUIRE(TextModel::FullTextOf(buffer) == "on,tw,thre");
+    REQUIRE(cursors == TextModel::Cursors{2, 5, 10});
+  }
+
+  SECTION("delete removes behind every cursor and clamps at the end") {
+    const auto cursors = TextModel::RemoveAtCursors(buffer, {0, 4, 12}, 0, 2);
+    REQUIRE(TextModel::FullTextOf(buffer) == "e,o,thre");
+    REQUIRE(cursors == TextModel::Cursors{0, 2, 8});
+  }
+
+  SECTION("merges cursors whose ranges overlap") {
+    const auto cursors = TextModel::RemoveAtCursors(buffer, {4, 5, 6}, 2, 0);
+    REQUIRE(TextModel::FullTextOf(buffer) == "ono,three");
+    REQUIRE(cursors == TextModel::Cursors{2});
+  }
+
+  SECTION("takes whole code points") {
+    TextModel::TextBuffer accented{TextModel::String{"caf\xC3\xA9,\xF0\x9F\x98\x80!"}};
+    const auto cursors = TextModel::RemoveAtCursors(accented, {5, 10}, 1, 0);
+    REQUIRE(TextModel::FullTextOf(accented) == "caf,!");
+    REQUIRE(cursors == TextModel::Cursors{3, 4});
+    TextModel::RemoveAtCursors(accented, {0}, 0, 2);
+    REQUIRE(TextModel::FullTextOf(accented) == "f,!");
+  }
+}
+
+
+TEST_CASE("Benchmark multi-cursor editing", "![benchmark]") {
+  static constexpr TextModel::Index DocumentSize{1 << 20};
+  static constexpr std::size_t CursorCount{10000};
+  static constexpr TextModel::Index Keystrokes{10};
+  std::mt19937 mt(20181120);
+  std::uniform_int_distribution<TextModel::Index> position(0, DocumentSize);
+  TextModel::Cursors cursors(CursorCount);
+  for (auto& cursor : cursors) {
+    cursor = position(mt);
+  }
+  std::sort(cursors.begin(), cursors.end());
+  cursors.erase(std::unique(cursors.begin(), cursors.end()), cursors.end());
+
+  // Every benchmark edits a buffer of its own, made right before it, so that
+  // both start from the same document and the cursors stay where they point,
+  // and making it is not timed. BENCHMARK runs its body once.
+  TextModel::TextBuffer batched{TextModel::String(DocumentSize, 'x')};
+  BENCHMARK("typing at 10k cursors over 1 MB, one batch per keystroke") {
+    auto moved = cursors;
+    for (TextModel::Index keystroke = 0; keystroke < Keystrokes; ++keystroke) {
+      moved = TextModel::InsertAtCursors(batched, moved, "a");
+    }
+    moved = TextModel::RemoveAtCursors(batched, moved, 1, 0);
+  }
+
+  TextModel::TextBuffer one_by_one{TextModel::String(DocumentSize, 'x')};
+  BENCHMARK("typing at 10k cursors over 1 MB, one insert per cursor") {
+    // Going from the last cursor back, a cursor has the keystrokes typed at
+    // the cursors before it and at itself in front of it.
+    for (TextModel::Index keystroke = 0; keystroke < Keystrokes; ++keystroke) {
+      for (std::size_t i = cursors.size(); i-- > 0;) {
+        one_by_one.insert(cursors[i] + (i + 1) * keystroke, "a");
+      }
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#include "TextModel/Cursors.h"
+#include <algorithm>
+
+namespace TextModel {
+  namespace {
+    void Normalise(Cursors& cursors) {
+      std::sort(cursors.begin(), cursors.end());
+      cursors.erase(std::unique(cursors.begin(), cursors.end()), cursors.end());
+    }
+  } // anonymous namespace
+
+
+  Cursors InsertAtCursors(Buffer& buffer, Cursors cursors, String const& text) {
+    Normalise(cursors);
+    const auto size = buffer.size();
+
+    std::vector<Edit> edits;
+    edits.reserve(cursors.size());
+    for (auto& cursor : cursors) {
+      cursor = std::min(cursor, size);
+      edits.push_back({Range{cursor, cursor}, text});
+    }
+    buffer.apply(edits);
+
+    for (std::size_t i = 0; i < cursors.size(); ++i) {
+      cursors[i] += (i + 1) * text.size();
+    }
+    return cursors;
+  }
+
+
+  Cursors RemoveAtCursors(Buffer& buffer, Cursors cursors, Index before, Index after) {
+    Normalise(cursors);
+    const auto size = buffer.size();
+    const auto code_points = buffer.code_point_index_of(size);
+
+    std::vector<Edit> edits;
+    edits.reserve(cursors.size());
+    for (const auto cursor : cursors) {
+      const auto at = buffer.code_point_index_of(std::min(cursor, size));
+      const auto start = buffer.offset_of_code_point(at - std::min(at, before));
+      const auto end = buffer.offset_of_code_point(std::min(code_points, at + after));
+      if (!edits.empty() && start <= edits.back().range.end) {
+        edits.back().range.end = std::max(edits.back().range.end, end);
+      }
+      else {
+        edits.push_back({Range{start, end}, String{}});
+      }
+    }
+    buffer.apply(edits);
+
+    Cursors result;
+    result.reserve(edits.size());
+    Index removed{0};
+    for (auto const& edit : edits) {
+      result.push_back(edit.range.start - removed);
+      removed += edit.range.end - edit.range.start;
+    }
+    return result;
+  }
+} // TextModel
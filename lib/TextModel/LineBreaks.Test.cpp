@@ -0,0 +1,63 @@
+#include "catch2/catch.hpp"
+#include "TextModel/LineBreaks.h"
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+TEST_CASE("Counting line breaks", "[unit]") {
+  std::string text(100, 'x');
+  for (auto position : {0, 15, 16, 31, 32, 63, 64, 99}) {
+    text[position] = '\n';
+  }
+
+  REQUIRE(TextModel::CountLineBreaks(text) == 8);
+  REQUIRE(TextModel::CountLineBreaks(std::string_view{text}.substr(1, 63)) == 5);
+  REQUIRE(TextModel::CountLineBreaks("") == 0);
+}
+
+
+TEST_CASE("Counting line breaks of a storage", "[unit]") {
+  std::string storage;
+  const auto view = [&storage](TextModel::Index start, TextModel::Index length) {
+    return std::string_view{storage}.substr(start, length);
+  };
+  TextModel::LineBreaks line_breaks;
+
+  SECTION("within a stride") {
+    storage = "one\ntwo\nthree\r\nfour";
+    REQUIRE(line_breaks.append(storage.substr(0, 8), 0) == 2);
+    REQUIRE(line_breaks.append(storage.substr(8), 8) == 1);
+
+    REQUIRE(line_breaks.size() == 3);
+    REQUIRE(line_breaks.count_before(19, view) == 3);
+    REQUIRE(line_breaks.count_before(8, view) - line_breaks.count_before(4, view) == 1);
+    REQUIRE(line_breaks.count_before(7, view) - line_breaks.count_before(4, view) == 0);
+    REQUIRE(line_breaks.offset_of(2, view) == 14);
+    REQUIRE(line_breaks.offset_of(1, view) == 7);
+  }
+
+  SECTION("across strides and the gaps between appends") {
+    constexpr auto Stride = TextModel::LineBreaks::Stride;
+    storage = std::string(3 * Stride + 10, '\n');
+    for (TextModel::Index i = 0; i < storage.size(); i += 3) {
+      storage[i] = 'x';
+    }
+    line_breaks.append(std::string_view{storage}.substr(0, Stride + 7), 0);
+    std::fill(storage.begin() + Stride + 7, storage.begin() + 2 * Stride, 'x');
+    line_breaks.append(std::string_view{storage}.substr(2 * Stride), 2 * Stride);
+
+    std::vector<TextModel::Index> positions;
+    for (TextModel::Index i = 0; i < storage.size(); ++i) {
+      if (storage[i] == '\n') {
+        REQUIRE(line_breaks.count_before(i, view) == positions.size());
+        positions.push_back(i);
+      }
+    }
+    REQUIRE(line_breaks.size() == positions.size());
+    REQUIRE(line_breaks.count_before(storage.size(), view) == positions.size());
+    for (TextModel::Index n = 0; n < positions.size(); ++n) {
+      REQUIRE(line_breaks.offset_of(n, view) == positions[n]);
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#include "TextModel/LineBreaks.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace TextModel {
+  Index CountLineBreaks(std::string_view text) {
+    auto const* const begin = text.data();
+    auto const* const end = begin + text.size();
+    auto const* current = begin;
+    Index count{0};
+
+#if defined(__AVX2__)
+    const auto wide_newlines = _mm256_set1_epi8('\n');
+    for (; end - current >= 32; current += 32) {
+      const auto block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(current));
+      count += static_cast<Index>(__builtin_popcount(static_cast<unsigned>(
+          _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, wide_newlines))
+      )));
+    }
+#endif
+#if defined(__SSE2__)
+    const auto newlines = _mm_set1_epi8('\n');
+    for (; end - current >= 16; current += 16) {
+      const auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(current));
+      count += static_cast<Index>(__builtin_popcount(static_cast<unsigned>(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(block, newlines))
+      )));
+    }
+#endif
+
+    return count + static_cast<Index>(std::count(current, end, '\n'));
+  }
+
+
+  Index LineBreaks::NthLineBreakIn(std::string_view text, Index n) {
+    auto from = text.data();
+    auto const* const end = text.data() + text.size();
+    for (;; ++from) {
+      from = static_cast<char const*>(
+          std::memchr(from, '\n', static_cast<std::size_t>(end - from))
+      );
+      if (!from || n-- == 0) {
+        break;
+      }
+    }
+    return from ? static_cast<Index>(from - text.data()) : text.size();
+  }
+
+
+  Index LineBreaks::append(std::string_view text, Index offset) {
+    while (checkpoints_.size() * Stride <= offset) {
+      checkpoints_.push_back(total_);
+    }
+    end_ = offset;
+
+    const auto before = total_;
+    Index done{0};
+    while (done < text.size()) {
+      const auto next_checkpoint = (end_ / Stride + 1) * Stride;
+      const auto length = std::min(text.size() - done, next_checkpoint - end_);
+      total_ += CountLineBreaks(text.substr(done, length));
+      done += length;
+      end_ += length;
+      if (end_ == next_checkpoint) {
+        checkpoints_.push_back(total_);
+      }
+    }
+    return total_ - before;
+  }
+} // TextModel
@@ -0,0 +1,63 @@
+#include "catch2/catch.hpp"
+#include "TextModel/MappedFile.h"
+#include "TextModel/TextBuffer.h"
+#include <cstdio>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace {
+  class TemporaryFile {
+    std::string path_;
+
+  public:
+    explicit TemporaryFile(std::string const& content) {
+      char path[] = "/tmp/TextModelMappedFile.XXXXXX";
+      const auto descriptor = ::mkstemp(path);
+      REQUIRE(descriptor >= 0);
+      REQUIRE(::write(descriptor, content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+      ::close(descriptor);
+      path_ = path;
+    }
+
+    ~TemporaryFile() { std::remove(path_.c_str()); }
+
+    std::string const& path() const { return path_; }
+  };
+} // anonymous namespace
+
+
+TEST_CASE("Mapping a file", "[unit]") {
+  SECTION("gives its whole content") {
+    const TemporaryFile file{"Hello,\nWorld!"};
+    const TextModel::MappedFile mapped{file.path()};
+    REQUIRE(mapped.text() == "Hello,\nWorld!");
+  }
+
+  SECTION("of zero length gives an empty text") {
+    const TemporaryFile file{""};
+    const TextModel::MappedFile mapped{file.path()};
+    REQUIRE(mapped.text().empty());
+  }
+
+  SECTION("that does not exist throws") {
+    REQUIRE_THROWS_AS(
+        TextModel::MappedFile{"/nonexistent/TextModelMappedFile"},
+        std::system_error
+    );
+  }
+}
+
+
+TEST_CASE("TextBuffer can be edited on top of a mapped file", "[unit]") {
+  const TemporaryFile file{"Hello, World!\nSecond line\n"};
+  TextModel::TextBuffer buffer{TextModel::MappedFile{file.path()}};
+  REQUIRE(buffer.size() == 26);
+  REQUIRE(buffer.line_count() == 3);
+
+  buffer.insert(7, "wonderful ");
+  buffer.remove(TextModel::Range{0, 7});
+  REQUIRE(TextModel::FullTextOf(buffer) == "wonderful World!\nSecond line\n");
+  REQUIRE(buffer.offset_of_line(1) == 17);
+}
@@ -0,0 +1,68 @@
+#include "TextModel/MappedFile.h"
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TextModel {
+  namespace {
+    [[noreturn]] void Fail(int descriptor, std::string const& what) {
+      const auto error = errno;
+      if (descriptor >= 0) {
+        ::close(descriptor);
+      }
+      throw std::system_error(error, std::generic_category(), what);
+    }
+  } // anonymous namespace
+
+
+  MappedFile::MappedFile(std::string const& path) {
+    const auto descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) {
+      Fail(descriptor, "MappedFile: cannot open " + path);
+    }
+
+    struct stat status{};
+    if (::fstat(descriptor, &status) != 0) {
+      Fail(descriptor, "MappedFile: cannot stat " + path);
+    }
+
+    size_ = static_cast<std::size_t>(status.st_size);
+    if (size_ > 0) {
+      auto* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if (mapping == MAP_FAILED) {
+        Fail(descriptor, "MappedFile: cannot map " + path);
+      }
+      data_ = static_cast<char const*>(mapping);
+    }
+    ::close(descriptor);
+  }
+
+
+  MappedFile::~MappedFile() {
+    if (data_) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+
+  MappedFile::MappedFile(MappedFile&& other) noexcept
+  : data_{std::exchange(other.data_, nullptr)}
+  , size_{std::exchange(other.size_, 0)} {}
+
+
+  MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+      }
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+} // TextModel
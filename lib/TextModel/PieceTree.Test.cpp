@@ -0,0 +1,147 @@
+#include "catch2/catch.hpp"
+#include "TextModel/PieceTree.h"
+#include <cstdlib>
+#include <vector>
+
+namespace {
+  std::vector<TextModel::Index> StartsOf(TextModel::PieceTree const& tree) {
+    std::vector<TextModel::Index> result;
+    TextModel::ForEachPiece(tree, TextModel::Range{0, tree.length()},
+        [&result](TextModel::Span const& piece) {
+          result.push_back(piece.start_in_storage);
+        }
+    );
+    return result;
+  }
+
+  bool IsBalanced(TextModel::PieceTree const& tree) {
+    if (tree.empty()) {
+      return true;
+    }
+    const auto left_height = tree.left().height();
+    const auto right_height = tree.right().height();
+    const auto difference = left_height > right_height
+        ? left_height - right_height
+        : right_height - left_height
+    ;
+    return difference <= 1 && IsBalanced(tree.left()) && IsBalanced(tree.right());
+  }
+
+  TextModel::Span Unmeasured(
+      TextModel::Storage storage, TextModel::Index start, TextModel::Index length
+  ) {
+    return TextModel::Span{storage, start, length};
+  }
+
+  TextModel::PieceTree SequenceOf(TextModel::Index count) {
+    TextModel::PieceTree result;
+    for (TextModel::Index i = 0; i < count; ++i) {
+      result = TextModel::Joined(
+          result, TextModel::Span{TextModel::Storage::Inserted, i * 10, 10}, {}
+      );
+    }
+    return result;
+  }
+} // anonymous namespace
+
+
+TEST_CASE("Appending pieces keeps the tree balanced", "[unit]") {
+  const auto tree = SequenceOf(1000);
+  REQUIRE(tree.length() == 10000);
+  REQUIRE(IsBalanced(tree));
+  REQUIRE(tree.height() <= 15);
+
+  const auto starts = StartsOf(tree);
+  REQUIRE(starts.size() == 1000);
+  REQUIRE(starts.front() == 0);
+  REQUIRE(starts.back() == 9990);
+}
+
+
+TEST_CASE("Splitting a piece tree", "[unit]") {
+  const auto tree = SequenceOf(100);
+
+  SECTION("at a piece boundary keeps the pieces whole") {
+    const auto [before, after] = TextModel::SplitAt(tree, 300, Unmeasured);
+    REQUIRE(before.length() == 300);
+    REQUIRE(after.length() == 700);
+    REQUIRE(StartsOf(before).size() == 30);
+    REQUIRE(IsBalanced(before));
+    REQUIRE(IsBalanced(after));
+  }
+
+  SECTION("in the middle of a piece cuts it in two") {
+    const auto [before, after] = TextModel::SplitAt(tree, 305, Unmeasured);
+    REQUIRE(before.length() == 305);
+    REQUIRE(after.length() == 695);
+    REQUIRE(StartsOf(before).back() == 300);
+    REQUIRE(StartsOf(after).front() == 305);
+  }
+
+  SECTION("beyond the end leaves everything on the left") {
+    const auto [before, after] = TextModel::SplitAt(tree, 5000, Unmeasured);
+    REQUIRE(before == tree);
+    REQUIRE(after.empty());
+  }
+}
+
+
+TEST_CASE("Concatenating piece trees of different heights", "[unit]") {
+  const auto small = SequenceOf(3);
+  const auto large = SequenceOf(500);
+  const auto joined = TextModel::Concatenated(small, large);
+  REQUIRE(joined.length() == small.length() + large.length());
+  REQUIRE(IsBalanced(joined));
+  REQUIRE(StartsOf(joined).size() == 503);
+}
+
+
+TEST_CASE("Random splits and concatenations stay balanced", "[unit]") {
+  std::srand(42);
+  auto tree = SequenceOf(200);
+  for (int round = 0; round < 500; ++round) {
+    const auto at = static_cast<TextModel::Index>(std::rand()) % tree.length();
+    const auto [before, after] = TextModel::SplitAt(tree, at, Unmeasured);
+    tree = TextModel::Concatenated(after, before);
+    REQUIRE(tree.length() == 2000);
+  }
+  REQUIRE(IsBalanced(tree));
+  REQUIRE(TextModel::IsConsistent(tree));
+}
+
+
+TEST_CASE("Consistency check notices stale cached lengths", "[unit]") {
+  using TextModel::PieceTree;
+  using TextModel::Span;
+  using TextModel::Storage;
+  const PieceTree leaf{{}, Span{Storage::Original, 0, 4}, {}};
+  REQUIRE(TextModel::IsConsistent(leaf));
+
+  auto stale = std::make_shared<PieceTree::Node>(*leaf.node());
+  stale->length = 5;
+  REQUIRE(!TextModel::IsConsistent(PieceTree{stale}));
+}
+
+
+TEST_CASE("Looking up pieces by offset and by line break", "[unit]") {
+  using TextModel::Span;
+  using TextModel::Storage;
+  TextModel::PieceTree tree;
+  for (TextModel::Index i = 0; i < 100; ++i) {
+    tree = TextModel::Joined(tree, Span{Storage::Original, i * 10, 10, i % 3}, {});
+  }
+  REQUIRE(tree.line_breaks() == 99);
+
+  SECTION("the piece under an offset knows where it starts") {
+    const auto found = TextModel::PieceAt(tree, 425);
+    REQUIRE(found.offset == 420);
+    REQUIRE(found.piece.start_in_storage == 420);
+    REQUIRE(found.line_breaks_before == 42);
+  }
+
+  SECTION("the piece holding a line break counts the ones before it") {
+    const auto found = TextModel::PieceWithLineBreak(tree, 43);
+    REQUIRE(found.piece.start_in_storage == 440);
+    REQUIRE(found.line_breaks_before == 43);
+  }
+}
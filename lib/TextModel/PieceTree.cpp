@@ -0,0 +1,357 @@
+#include "TextModel/PieceTree.h"
+
+namespace TextModel {
+  namespace {
+    using NodePtr = PieceTree::NodePtr;
+
+    Index LengthOf(NodePtr const& node) {
+      return node ? node->length : 0;
+    }
+
+    Index LineBreaksOf(NodePtr const& node) {
+      return node ? node->line_breaks : 0;
+    }
+
+    Index CodePointsOf(NodePtr const& node) {
+      return node ? node->code_points : 0;
+    }
+
+    Index Utf16UnitsOf(NodePtr const& node) {
+      return node ? node->utf16_units : 0;
+    }
+
+    std::size_t PiecesOf(NodePtr const& node) {
+      return node ? node->pieces : 0;
+    }
+
+    std::size_t HeightOf(NodePtr const& node) {
+      return node ? node->height : 0;
+    }
+
+    NodePtr MakeNode(NodePtr const& lhs, Span const& piece, NodePtr const& rhs) {
+      return std::make_shared<const PieceTree::Node>(lhs, piece, rhs);
+    }
+
+
+    NodePtr RotatedLeft(NodePtr const& node) {
+      auto const& right = node->right;
+      return MakeNode(
+          MakeNode(node->left, node->piece, right->left),
+          right->piece,
+          right->right
+      );
+    }
+
+
+    NodePtr RotatedRight(NodePtr const& node) {
+      auto const& left = node->left;
+      return MakeNode(
+          left->left,
+          left->piece,
+          MakeNode(left->right, node->piece, node->right)
+      );
+    }
+
+
+    // Precondition: lhs is taller than rhs by more than one level.
+    NodePtr JoinedRight(NodePtr const& lhs, Span const& piece, NodePtr const& rhs) {
+      auto const& inner = lhs->right;
+      if (HeightOf(inner) <= HeightOf(rhs) + 1) {
+        const auto joined = MakeNode(inner, piece, rhs);
+        if (joined->height <= HeightOf(lhs->left) + 1) {
+          return MakeNode(lhs->left, lhs->piece, joined);
+        }
+        else {
+          return RotatedLeft(MakeNode(lhs->left, lhs->piece, RotatedRight(joined)));
+        }
+      }
+      else {
+        const auto joined = JoinedRight(inner, piece, rhs);
+        const auto result = MakeNode(lhs->left, lhs->piece, joined);
+        if (joined->height <= HeightOf(lhs->left) + 1) {
+          return result;
+        }
+        else {
+          return RotatedLeft(result);
+        }
+      }
+    }
+
+
+    // Precondition: rhs is taller than lhs by more than one level.
+    NodePtr JoinedLeft(NodePtr const& lhs, Span const& piece, NodePtr const& rhs) {
+      auto const& inner = rhs->left;
+      if (HeightOf(inner) <= HeightOf(lhs) + 1) {
+        const auto joined = MakeNode(lhs, piece, inner);
+        if (joined->height <= HeightOf(rhs->right) + 1) {
+          return MakeNode(joined, rhs->piece, rhs->right);
+        }
+        else {
+          return RotatedRight(MakeNode(RotatedLeft(joined), rhs->piece, rhs->right));
+        }
+      }
+      else {
+        const auto joined = JoinedLeft(lhs, piece, inner);
+        const auto result = MakeNode(joined, rhs->piece, rhs->right);
+        if (joined->height <= HeightOf(rhs->right) + 1) {
+          return result;
+        }
+        else {
+          return RotatedRight(result);
+        }
+      }
+    }
+
+
+    NodePtr Joined(NodePtr const& lhs, Span const& piece, NodePtr const& rhs) {
+      if (HeightOf(lhs) > HeightOf(rhs) + 1) {
+        return JoinedRight(lhs, piece, rhs);
+      }
+      else if (HeightOf(rhs) > HeightOf(lhs) + 1) {
+        return JoinedLeft(lhs, piece, rhs);
+      }
+      else {
+        return MakeNode(lhs, piece, rhs);
+      }
+    }
+
+
+    NodePtr BalancedTreeOf(std::vector<Span> const& pieces, std::size_t begin, std::size_t end) {
+      if (begin == end) {
+        return {};
+      }
+      const auto middle = begin + (end - begin) / 2;
+      return MakeNode(
+          BalancedTreeOf(pieces, begin, middle),
+          pieces[middle],
+          BalancedTreeOf(pieces, middle + 1, end)
+      );
+    }
+
+
+    std::pair<Span, NodePtr> SplitFirst(NodePtr const& node) {
+      if (!node->left) {
+        return {node->piece, node->right};
+      }
+      else {
+        auto [first, rest] = SplitFirst(node->left);
+        return {first, Joined(rest, node->piece, node->right)};
+      }
+    }
+
+
+    std::pair<NodePtr, Span> SplitLast(NodePtr const& node) {
+      if (!node->right) {
+        return {node->left, node->piece};
+      }
+      else {
+        auto [rest, last] = SplitLast(node->right);
+        return {Joined(node->left, node->piece, rest), last};
+      }
+    }
+
+
+    std::pair<NodePtr, NodePtr> SplitAt(
+        NodePtr const& node, Index index, SpanMeasure const& measure
+    ) {
+      if (!node) {
+        return {};
+      }
+
+      const auto left_length = LengthOf(node->left);
+      const auto piece_end = left_length + node->piece.length;
+      if (index == left_length) {
+        return {node->left, Joined(NodePtr{}, node->piece, node->right)};
+      }
+      else if (index < left_length) {
+        auto [before, after] = SplitAt(node->left, index, measure);
+        return {before, Joined(after, node->piece, node->right)};
+      }
+      else if (index >= piece_end) {
+        auto [before, after] = SplitAt(node->right, index - piece_end, measure);
+        return {Joined(node->left, node->piece, before), after};
+      }
+      else {
+        auto const& piece = node->piece;
+        const auto relative_position = index - left_length;
+        const auto head = measure(
+            piece.storage,
+            piece.start_in_storage,
+            relative_position
+        );
+        const auto tail = measure(
+            piece.storage,
+            piece.start_in_storage + relative_position,
+            piece.length - relative_position
+        );
+        return {
+            Joined(node->left, head, NodePtr{}),
+            Joined(NodePtr{}, tail, node->right)
+        };
+      }
+    }
+
+
+    // Walks down to the piece holding the n-th unit of what measure counts;
+    // nodes and spans both have the counts measure can take.
+    template<class Measure>
+      PiecePosition PieceWith(PieceTree const& tree, Index n, Measure measure) {
+        auto const* node = tree.node().get();
+        PiecePosition position{node->piece, 0, 0, 0, 0};
+        const auto skip = [&position](auto const& measured) {
+          position.offset += measured.length;
+          position.line_breaks_before += measured.line_breaks;
+          position.code_points_before += measured.code_points;
+          position.utf16_units_before += measured.utf16_units;
+        };
+        for (;;) {
+          auto const* left = node->left.get();
+          const auto left_count = left ? measure(*left) : 0;
+          if (n < left_count) {
+            node = left;
+            continue;
+          }
+          if (left) {
+            skip(*left);
+          }
+          if (n < left_count + measure(node->piece)) {
+            position.piece = node->piece;
+            return position;
+          }
+          n -= left_count + measure(node->piece);
+          skip(node->piece);
+          node = node->right.get();
+        }
+      }
+
+
+    struct Measured {
+      bool consistent;
+      Index length;
+      Index line_breaks;
+      Index code_points;
+      Index utf16_units;
+      std::size_t pieces;
+      std::size_t height;
+    };
+
+    Measured Remeasured(NodePtr const& node) {
+      if (!node) {
+        return {true, 0, 0, 0, 0, 0, 0};
+      }
+
+      const auto left = Remeasured(node->left);
+      const auto right = Remeasured(node->right);
+      const auto length = left.length + node->piece.length + right.length;
+      const auto line_breaks = left.line_breaks + node->piece.line_breaks + right.line_breaks;
+      const auto code_points = left.code_points + node->piece.code_points + right.code_points;
+      const auto utf16_units = left.utf16_units + node->piece.utf16_units + right.utf16_units;
+      const auto pieces = left.pieces + 1 + right.pieces;
+      const auto height = std::max(left.height, right.height) + 1;
+      const auto balanced = left.height <= right.height + 1
+          && right.height <= left.height + 1;
+      return {
+          left.consistent && right.consistent && balanced
+              && node->piece.length > 0
+              && node->length == length
+              && node->line_breaks == line_breaks
+              && node->code_points == code_points
+              && node->utf16_units == utf16_units
+              && node->pieces == pieces
+              && node->height == height,
+          length,
+          line_breaks,
+          code_points,
+          utf16_units,
+          pieces,
+          height
+      };
+    }
+  } // anonymous namespace
+
+
+  PieceTree::Node::Node(NodePtr lhs, Span p, NodePtr rhs) noexcept
+  : left{std::move(lhs)}
+  , piece{p}
+  , right{std::move(rhs)}
+  , length{LengthOf(left) + piece.length + LengthOf(right)}
+  , line_breaks{LineBreaksOf(left) + piece.line_breaks + LineBreaksOf(right)}
+  , code_points{CodePointsOf(left) + piece.code_points + CodePointsOf(right)}
+  , utf16_units{Utf16UnitsOf(left) + piece.utf16_units + Utf16UnitsOf(right)}
+  , pieces{PiecesOf(left) + 1 + PiecesOf(right)}
+  , height{std::max(HeightOf(left), HeightOf(right)) + 1} {}
+
+
+  PieceTree::PieceTree(PieceTree const& lhs, Span piece, PieceTree const& rhs)
+  : root_{MakeNode(lhs.root_, piece, rhs.root_)} {}
+
+
+  PieceTree::PieceTree(std::vector<Span> const& pieces)
+  : root_{BalancedTreeOf(pieces, 0, pieces.size())} {}
+
+
+  PieceTree Joined(PieceTree const& lhs, Span const& piece, PieceTree const& rhs) {
+    return PieceTree{Joined(lhs.node(), piece, rhs.node())};
+  }
+
+
+  PieceTree Concatenated(PieceTree const& lhs, PieceTree const& rhs) {
+    if (lhs.empty()) {
+      return rhs;
+    }
+    else if (rhs.empty()) {
+      return lhs;
+    }
+    else {
+      const auto [first, rest] = SplitFirst(rhs.node());
+      return PieceTree{Joined(lhs.node(), first, rest)};
+    }
+  }
+
+
+  std::pair<PieceTree, Span> SplitLast(PieceTree const& tree) {
+    auto [rest, last] = SplitLast(tree.node());
+    return {PieceTree{std::move(rest)}, last};
+  }
+
+
+  std::pair<PieceTree, PieceTree> SplitAt(
+      PieceTree const& tree, Index index, SpanMeasure const& measure
+  ) {
+    if (index == 0) {
+      return {PieceTree{}, tree};
+    }
+    else if (index >= tree.length()) {
+      return {tree, PieceTree{}};
+    }
+    else {
+      auto [before, after] = SplitAt(tree.node(), index, measure);
+      return {PieceTree{std::move(before)}, PieceTree{std::move(after)}};
+    }
+  }
+
+
+  PiecePosition PieceAt(PieceTree const& tree, Index index) {
+    return PieceWith(tree, index, [](auto const& measured) { return measured.length; });
+  }
+
+
+  PiecePosition PieceWithLineBreak(PieceTree const& tree, Index n) {
+    return PieceWith(tree, n, [](auto const& measured) { return measured.line_breaks; });
+  }
+
+
+  PiecePosition PieceWithCodePoint(PieceTree const& tree, Index n) {
+    return PieceWith(tree, n, [](auto const& measured) { return measured.code_points; });
+  }
+
+
+  PiecePosition PieceWithUtf16Unit(PieceTree const& tree, Index n) {
+    return PieceWith(tree, n, [](auto const& measured) { return measured.utf16_units; });
+  }
+
+
+  bool IsConsistent(PieceTree const& tree) {
+    return Remeasured(tree.node()).consistent;
+  }
+} // TextModel
@@ -0,0 +1,116 @@
+#include "catch2/catch.hpp"
+#include "TextModel/MappedFile.h"
+#include "TextModel/SaveFile.h"
+#include "TextModel/TextBuffer.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  std::string ContentOf(std::string const& path) {
+    std::ifstream file{path, std::ios::binary};
+    return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+  }
+
+  std::string TemporaryPath() {
+    char path[] = "/tmp/TextModelSaveFile.XXXXXX";
+    const auto descriptor = ::mkstemp(path);
+    REQUIRE(descriptor >= 0);
+    ::close(descriptor);
+    return path;
+  }
+} // anonymous namespace
+
+
+TEST_CASE("Saving a buffer to a file", "[unit]") {
+  const auto path = TemporaryPath();
+
+  SECTION("writes the text of every piece in order") {
+    TextModel::TextBuffer buffer{TextModel::String(100000, 'o')};
+    for (TextModel::Index at = 0; at < 100000; at += 97) {
+      buffer.insert(at, "x");
+    }
+    REQUIRE(buffer.piece_count() > 256);
+    TextModel::SaveToFile(buffer, path);
+    REQUIRE(ContentOf(path) == TextModel::FullTextOf(buffer));
+  }
+
+  SECTION("keeps the permissions of the file it replaces") {
+    ::chmod(path.c_str(), 0640);
+    TextModel::SaveToFile(TextModel::TextBuffer{TextModel::String{"text"}}, path);
+    struct stat status{};
+    REQUIRE(::stat(path.c_str(), &status) == 0);
+    REQUIRE((status.st_mode & 0777) == 0640);
+  }
+
+  SECTION("keeps permissions the umask would not give a new file") {
+    ::chmod(path.c_str(), 0604);
+    const auto umask = ::umask(077);
+    TextModel::SaveToFile(TextModel::TextBuffer{TextModel::String{"text"}}, path);
+    ::umask(umask);
+    struct stat status{};
+    REQUIRE(::stat(path.c_str(), &status) == 0);
+    REQUIRE((status.st_mode & 0777) == 0604);
+  }
+
+  SECTION("keeps the owner and group of the file it replaces") {
+    // Only root can give a file to someone else, so others check their own.
+    const auto owner = ::geteuid() == 0 ? 1 : ::geteuid();
+    const auto group = ::geteuid() == 0 ? 1 : ::getegid();
+    REQUIRE(::chown(path.c_str(), owner, group) == 0);
+    TextModel::SaveToFile(TextModel::TextBuffer{TextModel::String{"text"}}, path);
+    struct stat status{};
+    REQUIRE(::stat(path.c_str(), &status) == 0);
+    REQUIRE(status.st_uid == owner);
+    REQUIRE(status.st_gid == group);
+  }
+
+  SECTION("replaces the file a symbolic link points to and keeps the link") {
+    const auto link = path + ".link";
+    REQUIRE(::symlink(path.c_str(), link.c_str()) == 0);
+    TextModel::SaveToFile(TextModel::TextBuffer{TextModel::String{"through the link"}}, link);
+    struct stat status{};
+    REQUIRE(::lstat(link.c_str(), &status) == 0);
+    REQUIRE(S_ISLNK(status.st_mode));
+    REQUIRE(ContentOf(path) == "through the link");
+    std::remove(link.c_str());
+  }
+
+  SECTION("creates a new file with the permissions the umask allows") {
+    std::remove(path.c_str());
+    const auto umask = ::umask(027);
+    TextModel::SaveToFile(TextModel::TextBuffer{TextModel::String{"text"}}, path);
+    ::umask(umask);
+    struct stat status{};
+    REQUIRE(::stat(path.c_str(), &status) == 0);
+    REQUIRE((status.st_mode & 0777) == 0640);
+    REQUIRE(ContentOf(path) == "text");
+  }
+
+  SECTION("can replace the file a buffer is mapping") {
+    {
+      std::ofstream file{path, std::ios::binary};
+      file << "Hello, World!";
+    }
+    TextModel::TextBuffer buffer{TextModel::MappedFile{path}};
+    buffer.insert(7, "wonderful ");
+    TextModel::SaveToFile(buffer, path);
+    REQUIRE(ContentOf(path) == "Hello, wonderful World!");
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, wonderful World!");
+  }
+
+  std::remove(path.c_str());
+}
+
+
+TEST_CASE("Saving into a directory that does not exist throws", "[unit]") {
+  const TextModel::TextBuffer buffer{TextModel::String{"text"}};
+  REQUIRE_THROWS_AS(
+      TextModel::SaveToFile(buffer, "/nonexistent/TextModelSaveFile"),
+      std::system_error
+  );
+}
@@ -0,0 +1,183 @@
+#include "TextModel/SaveFile.h"
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace TextModel {
+  namespace {
+    [[noreturn]] void Fail(int error, std::string const& what) {
+      throw std::system_error(error, std::generic_category(), what);
+    }
+
+
+    // Creates a new file next to path with the mode any new file gets: 0666
+    // less the umask. Returns -1 with errno set when it cannot.
+    int CreatedNextTo(std::string const& path, std::string& created_path) {
+      static std::atomic<unsigned> created{0};
+      for (;;) {
+        created_path = path + ".save." + std::to_string(::getpid())
+            + "." + std::to_string(created.fetch_add(1, std::memory_order_relaxed));
+        const auto descriptor = ::open(created_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (descriptor >= 0 || errno != EEXIST) {
+          return descriptor;
+        }
+      }
+    }
+
+
+    // The file path refers to through any symbolic links, or path itself
+    // when it does not exist yet.
+    std::string Resolved(std::string const& path) {
+      const std::unique_ptr<char, decltype(&std::free)> resolved{::realpath(path.c_str(), nullptr), &std::free};
+      return resolved ? std::string{resolved.get()} : path;
+    }
+
+
+    // Gives the file open as descriptor the owner, group and permissions of
+    // existing. An owner or group the process may not give away is left as
+    // it is; the permissions are set after it, as a change of owner clears
+    // the set-user-ID and set-group-ID bits. Returns 0 or the error.
+    int MatchFile(int descriptor, struct stat const& existing) {
+      if (::fchown(descriptor, existing.st_uid, existing.st_gid) != 0 && errno != EPERM) {
+        return errno;
+      }
+      return ::fchmod(descriptor, existing.st_mode & 07777) == 0 ? 0 : errno;
+    }
+
+
+    // Makes a rename in the directory holding path durable.
+    int SyncDirectoryOf(std::string const& path) {
+      const auto slash = path.rfind('/');
+      const auto directory = slash == std::string::npos
+          ? std::string{"."}
+          : path.substr(0, slash == 0 ? 1 : slash)
+      ;
+      const auto descriptor = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (descriptor < 0) {
+        return errno;
+      }
+      const auto error = ::fsync(descriptor) == 0 ? 0 : errno;
+      ::close(descriptor);
+      return error;
+    }
+
+
+    // Collects chunks into a fixed number of iovecs and writes them out with
+    // one writev whenever they are all used. A writev that writes nothing
+    // fails with EIO rather than being retried forever.
+    class VectoredWriter {
+      static constexpr std::size_t BatchSize{256};
+
+      int descriptor_;
+      std::array<iovec, BatchSize> batch_;
+      std::size_t used_{0};
+      int error_{0};
+
+    public:
+      explicit VectoredWriter(int descriptor) : descriptor_{descriptor} {}
+
+      int error() const noexcept { return error_; }
+
+      void add(std::string_view chunk) {
+        if (error_ || chunk.empty()) {
+          return;
+        }
+        batch_[used_++] = iovec{const_cast<char*>(chunk.data()), chunk.size()};
+        if (used_ == BatchSize) {
+          flush();
+        }
+      }
+
+      void flush() {
+        auto* next = batch_.data();
+        auto remaining = used_;
+        used_ = 0;
+        while (!error_ && remaining > 0) {
+          const auto written = ::writev(descriptor_, next, static_cast<int>(remaining));
+          if (written < 0) {
+            if (errno != EINTR) {
+              error_ = errno;
+            }
+            continue;
+          }
+          if (written == 0) {
+            error_ = EIO;
+            continue;
+          }
+
+          auto left = static_cast<std::size_t>(written);
+          while (remaining > 0 && left >= next->iov_len) {
+            left -= next->iov_len;
+            ++next;
+            --remaining;
+          }
+          if (remaining > 0) {
+            next->iov_base = static_cast<char*>(next->iov_base) + left;
+            next->iov_len -= left;
+          }
+        }
+      }
+    };
+  } // anonymous namespace
+
+
+  void SaveToFile(ReadOnlyBuffer const& buffer, std::string const& path) {
+    const auto target = Resolved(path);
+    std::string temporary_path;
+    const auto descriptor = CreatedNextTo(target, temporary_path);
+    if (descriptor < 0) {
+      Fail(errno, "SaveToFile: cannot create a temporary file for " + path);
+    }
+
+    const auto abandon = [&](int error, std::string const& what) {
+      ::close(descriptor);
+      std::remove(temporary_path.c_str());
+      Fail(error, what);
+    };
+
+    struct stat existing{};
+    if (::stat(target.c_str(), &existing) == 0) {
+      if (const auto error = MatchFile(descriptor, existing)) {
+        abandon(error, "SaveToFile: cannot set the permissions of " + path);
+      }
+    }
+
+    VectoredWriter writer{descriptor};
+    buffer.for_each_chunk(Range{0, buffer.size()},
+        [&writer](std::string_view chunk) {
+          writer.add(chunk);
+        }
+    );
+    writer.flush();
+    if (writer.error()) {
+      abandon(writer.error(), "SaveToFile: cannot write " + path);
+    }
+
+    if (::fsync(descriptor) != 0) {
+      abandon(errno, "SaveToFile: cannot sync " + path);
+    }
+    if (::close(descriptor) != 0) {
+      const auto error = errno;
+      std::remove(temporary_path.c_str());
+      Fail(error, "SaveToFile: cannot close " + path);
+    }
+    if (std::rename(temporary_path.c_str(), target.c_str()) != 0) {
+      const auto error = errno;
+      std::remove(temporary_path.c_str());
+      Fail(error, "SaveToFile: cannot replace " + path);
+    }
+    if (const auto error = SyncDirectoryOf(target)) {
+      Fail(error, "SaveToFile: cannot sync the directory of " + path);
+    }
+  }
+} // TextModel
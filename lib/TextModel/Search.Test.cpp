@@ -0,0 +1,105 @@
+#include "catch2/catch.hpp"
+#include "TextModel/Search.h"
+#include "TextModel/TextBuffer.h"
+#include <random>
+
+namespace {
+  std::vector<TextModel::Index> MatchesIn(TextModel::String const& text, std::string_view needle) {
+    std::vector<TextModel::Index> result;
+    for (auto found = text.find(needle); found != TextModel::String::npos; found = text.find(needle, found + needle.size())) {
+      result.push_back(found);
+    }
+    return result;
+  }
+
+  // The text "abcab...", cut into many small pieces by inserting and removing.
+  TextModel::TextBuffer FragmentedBuffer(TextModel::String& expected, std::mt19937& mt) {
+    TextModel::TextBuffer buffer;
+    static const TextModel::String Words[] = {"ab", "a", "bca", "c", "abcabc", "\n"};
+    std::uniform_int_distribution<std::size_t> word(0, 5);
+    for (int i = 0; i < 400; ++i) {
+      std::uniform_int_distribution<TextModel::Index> position(0, expected.size());
+      const auto at = position(mt);
+      const auto& text = Words[word(mt)];
+      buffer.insert(at, text);
+      expected.insert(at, text);
+    }
+    return buffer;
+  }
+} // anonymous namespace
+
+
+TEST_CASE("Searching a buffer", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"Hello, World! Hello!"}};
+  buffer.insert(3, "l");
+  buffer.insert(4, "lo Hel");
+
+  SECTION("finds matches straddling pieces") {
+    REQUIRE(TextModel::FullTextOf(buffer) == "Helllo Hello, World! Hello!");
+    REQUIRE(TextModel::FindAll(buffer, "Hello") == std::vector<TextModel::Index>{7, 21});
+    REQUIRE(TextModel::FindAll(buffer, "lllo H") == std::vector<TextModel::Index>{2});
+  }
+
+  SECTION("finds the next match from an offset") {
+    REQUIRE(TextModel::FindNext(buffer, "Hello") == 7);
+    REQUIRE(TextModel::FindNext(buffer, "Hello", 8) == 21);
+    REQUIRE(TextModel::FindNext(buffer, "Hello", 22) == TextModel::NotFound);
+  }
+
+  SECTION("does not count overlapping matches") {
+    REQUIRE(TextModel::CountOf(buffer, "ll") == 3);
+  }
+
+  SECTION("with an empty needle finds nothing") {
+    REQUIRE(TextModel::CountOf(buffer, "") == 0);
+    REQUIRE(TextModel::FindNext(buffer, "") == TextModel::NotFound);
+  }
+}
+
+
+TEST_CASE("Searching fragmented buffers finds what searching their text finds", "[unit]") {
+  std::mt19937 mt(20181203);
+  for (int round = 0; round < 10; ++round) {
+    TextModel::String expected;
+    const auto buffer = FragmentedBuffer(expected, mt);
+    for (const auto needle : {"a", "ab", "abc", "cab", "bcab", "abcabcab", "c\nab", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"}) {
+      const auto expected_matches = MatchesIn(expected, needle);
+      REQUIRE(TextModel::FindAll(buffer, needle) == expected_matches);
+      REQUIRE(TextModel::CountOf(buffer, needle) == expected_matches.size());
+      const auto from = expected.size() / 2;
+      REQUIRE(TextModel::FindNext(buffer, needle, from) == expected.find(needle, from));
+    }
+  }
+}
+
+
+TEST_CASE("Benchmark searching", "![benchmark]") {
+  static constexpr TextModel::Index DocumentSize{100 << 20};
+  std::mt19937 mt(20181204);
+  TextModel::String text(DocumentSize, ' ');
+  std::uniform_int_distribution<int> letter('a', 'z');
+  for (auto& character : text) {
+    character = static_cast<char>(letter(mt));
+  }
+
+  TextModel::TextBuffer buffer{text};
+  std::vector<TextModel::Edit> edits;
+  for (TextModel::Index at = 0; at < DocumentSize; at += 1000) {
+    edits.push_back({TextModel::Range{at, at + 1}, "needle"});
+  }
+  buffer.apply(edits);
+  WARN("pieces: " << buffer.piece_count());
+
+  BENCHMARK("counting matches in a fragmented 100 MB buffer") {
+    CHECK(TextModel::CountOf(buffer, "needle") >= edits.size());
+  }
+
+  BENCHMARK("counting matches after copying the text out") {
+    const auto full_text = TextModel::FullTextOf(buffer);
+    CHECK(MatchesIn(full_text, "needle").size() >= edits.size());
+  }
+
+  BENCHMARK("finding a needle that is not there") {
+    CHECK(TextModel::FindNext(buffer, "needles!") == TextModel::NotFound);
+  }
+}
@@ -0,0 +1,225 @@
+#include "TextModel/Search.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace TextModel {
+  namespace {
+    bool MatchesAt(char const* text, std::string_view needle) {
+      return needle.size() < 3
+          || std::memcmp(text + 1, needle.data() + 1, needle.size() - 2) == 0;
+    }
+
+
+    // Calls function with every, also overlapping, occurrence of needle in
+    // text in increasing order. Candidates are the positions where both the
+    // first and the last byte of the needle match, checked a whole vector of
+    // positions at a time; only those get compared in full. Returns false
+    // when function asked to stop.
+    template<class Function>
+      bool ForEachOccurrence(std::string_view text, std::string_view needle, Function& function) {
+        const auto length = needle.size();
+        if (length == 0 || text.size() < length) {
+          return true;
+        }
+
+        auto const* const data = text.data();
+        const auto last_start = text.size() - length;
+        Index position{0};
+
+#if defined(__AVX2__)
+        const auto wide_firsts = _mm256_set1_epi8(needle.front());
+        const auto wide_lasts = _mm256_set1_epi8(needle.back());
+        for (; position + 31 <= last_start; position += 32) {
+          const auto firsts = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + position));
+          const auto lasts = _mm256_loadu_si256(
+              reinterpret_cast<__m256i const*>(data + position + length - 1)
+          );
+          auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(
+              _mm256_cmpeq_epi8(firsts, wide_firsts),
+              _mm256_cmpeq_epi8(lasts, wide_lasts)
+          )));
+          while (mask) {
+            const auto candidate = position + static_cast<Index>(__builtin_ctz(mask));
+            if (MatchesAt(data + candidate, needle) && !function(candidate)) {
+              return false;
+            }
+            mask &= mask - 1;
+          }
+        }
+#endif
+#if defined(__SSE2__)
+        const auto narrow_firsts = _mm_set1_epi8(needle.front());
+        const auto narrow_lasts = _mm_set1_epi8(needle.back());
+        for (; position + 15 <= last_start; position += 16) {
+          const auto firsts = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + position));
+          const auto lasts = _mm_loadu_si128(
+              reinterpret_cast<__m128i const*>(data + position + length - 1)
+          );
+          auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(
+              _mm_cmpeq_epi8(firsts, narrow_firsts),
+              _mm_cmpeq_epi8(lasts, narrow_lasts)
+          )));
+          while (mask) {
+            const auto candidate = position + static_cast<Index>(__builtin_ctz(mask));
+            if (MatchesAt(data + candidate, needle) && !function(candidate)) {
+              return false;
+            }
+            mask &= mask - 1;
+          }
+        }
+#endif
+
+        while (position <= last_start) {
+          const auto found = static_cast<char const*>(
+              std::memchr(data + position, needle.front(), last_start - position + 1)
+          );
+          if (!found) {
+            break;
+          }
+          position = static_cast<Index>(found - data);
+          if (data[position + length - 1] == needle.back()
+              && MatchesAt(data + position, needle)
+              && !function(position)) {
+            return false;
+          }
+          ++position;
+        }
+        return true;
+      }
+
+
+    // Finds the non-overlapping matches in a text fed to it in consecutive
+    // chunks. The bytes at the end of the stream that could still start a
+    // match, fewer than the needle's length, are kept until the next chunk.
+    class StreamMatcher {
+      std::string_view needle_;
+      std::string pending_;
+      Index pending_offset_{0};
+      Index next_allowed_{0};
+      bool stopped_{false};
+
+      template<class Function>
+        bool report(Index offset, Function& function) {
+          if (offset < next_allowed_) {
+            return true;
+          }
+          next_allowed_ = offset + needle_.size();
+          stopped_ = !function(offset);
+          return !stopped_;
+        }
+
+    public:
+      StreamMatcher(std::string_view needle, Index from)
+      : needle_{needle}
+      , pending_offset_{from}
+      , next_allowed_{from} {}
+
+      bool stopped() const noexcept { return stopped_; }
+
+      // Calls function with the offset of every match, which returns whether
+      // to go on searching.
+      template<class Function>
+        void feed(std::string_view chunk, Index offset, Function& function) {
+          if (stopped_ || needle_.empty()) {
+            return;
+          }
+
+          const auto length = needle_.size();
+          Index decided{0};
+          if (!pending_.empty()) {
+            auto window = pending_;
+            window.append(chunk.data(), std::min(chunk.size(), length - 1));
+            auto report_boundary = [this, &function](Index position) {
+              return position >= pending_.size()
+                  || report(pending_offset_ + position, function);
+            };
+            if (!ForEachOccurrence(window, needle_, report_boundary)) {
+              return;
+            }
+            decided = window.size() >= length
+                ? std::min(pending_.size(), window.size() - length + 1)
+                : 0
+            ;
+          }
+
+          auto report_inner = [this, offset, &function](Index position) {
+            return report(offset + position, function);
+          };
+          if (!ForEachOccurrence(chunk, needle_, report_inner)) {
+            return;
+          }
+
+          if (decided < pending_.size()) {
+            // The chunk was too short to decide all pending positions.
+            pending_.erase(0, decided);
+            pending_offset_ += decided;
+            pending_.append(chunk.data(), chunk.size());
+          }
+          else {
+            const auto tail = std::min(chunk.size(), length - 1);
+            pending_.assign(chunk.data() + chunk.size() - tail, tail);
+            pending_offset_ = offset + chunk.size() - tail;
+          }
+        }
+    };
+
+
+    template<class Function>
+      void ForEachMatch(ReadOnlyBuffer const& buffer, std::string_view needle, Function function) {
+        StreamMatcher matcher{needle, 0};
+        Index offset{0};
+        buffer.for_each_chunk(Range{0, buffer.size()},
+            [&matcher, &function, &offset](std::string_view chunk) {
+              matcher.feed(chunk, offset, function);
+              offset += chunk.size();
+            }
+        );
+      }
+  } // anonymous namespace
+
+
+  Index FindNext(ReadOnlyBuffer const& buffer, std::string_view needle, Index from) {
+    static constexpr Index Window{1 << 20};
+    StreamMatcher matcher{needle, from};
+    Index found{NotFound};
+    auto first_match = [&found](Index offset) {
+      found = offset;
+      return false;
+    };
+
+    for (auto start = from; start < buffer.size() && !matcher.stopped(); start += Window) {
+      buffer.for_each_chunk(Range{start, start + Window},
+          [&matcher, &first_match, offset = start](std::string_view chunk) mutable {
+            matcher.feed(chunk, offset, first_match);
+            offset += chunk.size();
+          }
+      );
+    }
+    return found;
+  }
+
+
+  std::vector<Index> FindAll(ReadOnlyBuffer const& buffer, std::string_view needle) {
+    std::vector<Index> result;
+    ForEachMatch(buffer, needle, [&result](Index offset) {
+      result.push_back(offset);
+      return true;
+    });
+    return result;
+  }
+
+
+  Index CountOf(ReadOnlyBuffer const& buffer, std::string_view needle) {
+    Index result{0};
+    ForEachMatch(buffer, needle, [&result](Index) {
+      ++result;
+      return true;
+    });
+    return result;
+  }
+} // TextModel
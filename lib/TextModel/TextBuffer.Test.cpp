@@ -1,6 +1,18 @@
 #include "catch2/catch.hpp"
 #include "TextModel/TextBuffer.h"
+#include "TextModel/Utf8.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 TEST_CASE("Building and reading from TextBuffers", "[unit]") {
   TextModel::TextBuffer buffer;
@@ -70,16 +82,610 @@ TEST_CASE("TextBuffer can be constructed from a string", "[unit]") {
   REQUIRE(TextModel::FullTextOf(buffer) == "Hello, World!");
 }
 
+TEST_CASE("The size follows random edits", "[unit]") {
+  std::mt19937 mt(20181024);
+  TextModel::TextBuffer buffer{TextModel::String{"The quick brown fox"}};
+  TextModel::String expected{"The quick brown fox"};
+  for (int edit = 0; edit < 2000; ++edit) {
+    std::uniform_int_distribution<TextModel::Index> position(0, expected.size());
+    const auto start = position(mt);
+    if (edit % 3 == 0) {
+      const auto end = std::min(expected.size(), start + position(mt) % 8);
+      buffer.remove(TextModel::Range{start, end});
+      expected.erase(start, end - start);
+    }
+    else {
+      buffer.insert(start, "jumps");
+      expected.insert(start, "jumps");
+    }
+    REQUIRE(buffer.size() == expected.size());
+  }
+  REQUIRE(TextModel::FullTextOf(buffer) == expected);
+}
+
+TEST_CASE("Reading a range in chunks", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"Hello, World!"}};
+  buffer.insert(7, "wonderful ");
+  std::vector<std::string_view> chunks;
+  buffer.for_each_chunk(TextModel::Range{3, 20},
+      [&chunks](std::string_view chunk) { chunks.push_back(chunk); }
+  );
+
+  SECTION("gives one view per piece in the range") {
+    REQUIRE(chunks == std::vector<std::string_view>{"lo, ", "wonderful ", "Wor"});
+  }
+
+  SECTION("points into the storage instead of copies") {
+    std::vector<std::string_view> again;
+    buffer.for_each_chunk(TextModel::Range{3, 20},
+        [&again](std::string_view chunk) { again.push_back(chunk); }
+    );
+    REQUIRE(chunks[1].data() == again[1].data());
+  }
+
+  SECTION("can be appended to an existing string") {
+    TextModel::String text{"> "};
+    buffer.text_of(TextModel::Range{7, 17}, text);
+    REQUIRE(text == "> wonderful ");
+  }
+}
+
+TEST_CASE("Typing sequentially", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"Hello, World!"}};
+  const TextModel::String typed{"wonderful\n "};
+  for (TextModel::Index i = 0; i < typed.size(); ++i) {
+    buffer.insert(7 + i, typed.substr(i, 1));
+  }
+
+  SECTION("extends a single inserted piece") {
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, wonderful\n World!");
+    REQUIRE(buffer.piece_count() == 3);
+    REQUIRE(buffer.line_count() == 2);
+  }
+
+  SECTION("after moving the cursor starts a new piece") {
+    buffer.insert(0, ">");
+    buffer.insert(1, " ");
+    REQUIRE(TextModel::FullTextOf(buffer) == "> Hello, wonderful\n World!");
+    REQUIRE(buffer.piece_count() == 4);
+  }
+
+  SECTION("after deleting the last character starts a new piece") {
+    buffer.remove(TextModel::Range{17, 18});
+    buffer.insert(17, "!");
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, wonderful\n!World!");
+    REQUIRE(buffer.piece_count() == 4);
+  }
+}
+
+TEST_CASE("Typing across the blocks of inserted text", "[unit]") {
+  TextModel::TextBuffer buffer;
+  TextModel::String expected;
+  for (TextModel::Index i = 0; i < TextModel::AppendStorage::BlockSize + 10; ++i) {
+    const TextModel::String key(1, static_cast<char>('a' + i % 26));
+    buffer.insert(i, key);
+    expected += key;
+  }
+  REQUIRE(TextModel::FullTextOf(buffer) == expected);
+  REQUIRE(buffer.piece_count() == 2);
+}
+
+TEST_CASE("Undoing and redoing edits", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"Hello, World!"}};
+  REQUIRE(!buffer.can_undo());
+  REQUIRE(!buffer.undo());
+
+  buffer.insert(7, "wonderful ");
+  buffer.remove(TextModel::Range{0, 7});
+  REQUIRE(TextModel::FullTextOf(buffer) == "wonderful World!");
+
+  SECTION("steps back one edit at a time") {
+    REQUIRE(buffer.undo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, wonderful World!");
+    REQUIRE(buffer.undo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, World!");
+    REQUIRE(!buffer.undo());
+    REQUIRE(buffer.line_count() == 1);
+  }
+
+  SECTION("can be redone until something new is edited") {
+    buffer.undo();
+    buffer.undo();
+    REQUIRE(buffer.redo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, wonderful World!");
+    buffer.insert(0, "Oh, ");
+    REQUIRE(!buffer.can_redo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Oh, Hello, wonderful World!");
+  }
+}
+
+TEST_CASE("Undoing typing", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"Hello!"}};
+  for (auto const* key : {",", " ", "W", "o", "r", "l", "d"}) {
+    buffer.insert(buffer.size() - 1, key);
+  }
+  REQUIRE(TextModel::FullTextOf(buffer) == "Hello, World!");
+
+  SECTION("takes back a run of keystrokes in one step") {
+    REQUIRE(buffer.undo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello!");
+    REQUIRE(!buffer.can_undo());
+    REQUIRE(buffer.redo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, World!");
+  }
+
+  SECTION("starts a new step after another edit") {
+    buffer.remove(TextModel::Range{5, 6});
+    buffer.insert(5, ";");
+    buffer.insert(6, ";");
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello;; World!");
+    REQUIRE(buffer.undo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello World!");
+    REQUIRE(buffer.undo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, World!");
+  }
+
+  SECTION("starts a new step after undoing") {
+    buffer.undo();
+    buffer.redo();
+    buffer.insert(12, "s");
+    REQUIRE(buffer.undo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, World!");
+  }
+
+  SECTION("can be forgotten") {
+    buffer.clear_history();
+    REQUIRE(!buffer.can_undo());
+    REQUIRE(!buffer.undo());
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, World!");
+  }
+}
+
+TEST_CASE("Snapshots of a TextBuffer", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"Hello, World!"}};
+  const auto saved = buffer.snapshot();
+
+  buffer.insert(5, " there");
+  REQUIRE(buffer.snapshot() != saved);
+  REQUIRE(saved.size() == 13);
+
+  SECTION("can be restored as an undoable edit") {
+    buffer.restore(saved);
+    REQUIRE(buffer.snapshot() == saved);
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello, World!");
+    buffer.undo();
+    REQUIRE(TextModel::FullTextOf(buffer) == "Hello there, World!");
+  }
+
+  SECTION("are reached again by undoing") {
+    buffer.undo();
+    REQUIRE(buffer.snapshot() == saved);
+  }
+
+  SECTION("keep reading the text they were taken of") {
+    REQUIRE(TextModel::FullTextOf(saved) == "Hello, World!");
+    const auto edited = buffer.snapshot();
+    buffer.remove(TextModel::Range{0, 5});
+    REQUIRE(TextModel::FullTextOf(edited) == "Hello there, World!");
+    REQUIRE(edited.text_of(TextModel::Range{6, 11}) == "there");
+  }
+
+  SECTION("stay readable after the buffer is gone") {
+    auto moved = std::make_unique<TextModel::TextBuffer>(std::move(buffer));
+    const auto edited = moved->snapshot();
+    moved.reset();
+    REQUIRE(TextModel::FullTextOf(edited) == "Hello there, World!");
+  }
+}
+
+
+TEST_CASE("Reading snapshots from other threads while editing", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"The original text\n"}};
+  std::mutex mutex;
+  std::condition_variable published;
+  std::deque<std::pair<TextModel::TextBuffer::Snapshot, TextModel::String>> queue;
+  bool done{false};
+  std::atomic<int> mismatches{0};
+  std::atomic<int> checked{0};
+
+  // Only handing the snapshots over is synchronised, reading them is not.
+  const auto read = [&]() {
+    for (;;) {
+      std::unique_lock<std::mutex> lock{mutex};
+      published.wait(lock, [&]() { return done || !queue.empty(); });
+      if (queue.empty()) {
+        return;
+      }
+      const auto [snapshot, expected] = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+
+      TextModel::String chunked;
+      snapshot.for_each_chunk(TextModel::Range{0, snapshot.size()},
+          [&chunked](std::string_view chunk) { chunked.append(chunk); }
+      );
+      const auto middle = snapshot.size() / 2;
+      if (snapshot.size() != expected.size()
+          || TextModel::FullTextOf(snapshot) != expected
+          || chunked != expected
+          || snapshot.text_of(TextModel::Range{middle, middle + 100}) != expected.substr(middle, 100)) {
+        ++mismatches;
+      }
+      ++checked;
+    }
+  };
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back(read);
+  }
+
+  std::mt19937 generator{14};
+  static constexpr int Edits{2000};
+  for (int i = 0; i < Edits; ++i) {
+    const auto size = buffer.size();
+    if (size > 32 * 1024 && generator() % 2 == 0) {
+      const auto start = generator() % size;
+      buffer.remove(TextModel::Range{start, std::min(size, start + generator() % 4096)});
+    }
+    else {
+      // Large insertions often leave the current block, so the readers also
+      // race against the storage publishing new ones.
+      const auto length = 1 + generator() % 3000;
+      buffer.insert(generator() % (size + 1), TextModel::String(length, static_cast<char>('a' + i % 26)));
+    }
+
+    auto snapshot = buffer.snapshot();
+    auto expected = TextModel::FullTextOf(buffer);
+    {
+      const std::lock_guard<std::mutex> lock{mutex};
+      queue.emplace_back(std::move(snapshot), std::move(expected));
+    }
+    published.notify_one();
+  }
+  {
+    const std::lock_guard<std::mutex> lock{mutex};
+    done = true;
+  }
+  published.notify_all();
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  REQUIRE(checked == Edits);
+  REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("Applying a batch of edits", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"one two three four"}};
+  buffer.insert(3, ",");
+
+  SECTION("replaces every range of the original text") {
+    buffer.apply({
+        {TextModel::Range{0, 3}, "1"},
+        {TextModel::Range{5, 8}, "2"},
+        {TextModel::Range{9, 9}, "and "},
+        {TextModel::Range{19, 19}, "!"},
+    });
+    REQUIRE(TextModel::FullTextOf(buffer) == "1, 2 and three four!");
+  }
+
+  SECTION("is a single undo step") {
+    buffer.apply({
+        {TextModel::Range{0, 4}, ""},
+        {TextModel::Range{8, 15}, "\n"},
+    });
+    REQUIRE(TextModel::FullTextOf(buffer) == " two\nfour");
+    REQUIRE(buffer.line_count() == 2);
+    buffer.undo();
+    REQUIRE(TextModel::FullTextOf(buffer) == "one, two three four");
+  }
+
+  SECTION("rejects overlapping edits") {
+    const std::vector<TextModel::Edit> overlapping{
+        {TextModel::Range{0, 5}, "a"},
+        {TextModel::Range{4, 6}, "b"},
+    };
+    REQUIRE_THROWS_AS(buffer.apply(overlapping), std::invalid_argument);
+    REQUIRE(TextModel::FullTextOf(buffer) == "one, two three four");
+  }
+}
+
+TEST_CASE("A batch of edits does what applying them back to front does", "[unit]") {
+  std::mt19937 mt(20181115);
+  TextModel::TextBuffer batched{TextModel::String(1000, '.')};
+  TextModel::TextBuffer sequential{TextModel::String(1000, '.')};
+  for (int round = 0; round < 50; ++round) {
+    std::vector<TextModel::Edit> edits;
+    std::uniform_int_distribution<TextModel::Index> gap(0, 40);
+    for (auto at = gap(mt); at < batched.size(); at += gap(mt)) {
+      const auto end = std::min(batched.size(), at + gap(mt) % 5);
+      edits.push_back({TextModel::Range{at, end}, TextModel::String(gap(mt) % 4, 'a' + round % 26)});
+      at = end;
+    }
+
+    batched.apply(edits);
+    for (auto edit = edits.rbegin(); edit != edits.rend(); ++edit) {
+      sequential.remove(edit->range);
+      sequential.insert(edit->range.start, edit->text);
+    }
+    REQUIRE(TextModel::FullTextOf(batched) == TextModel::FullTextOf(sequential));
+  }
+}
+
+TEST_CASE("Replacing every match", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"one fish, two fish,"}};
+  buffer.insert(buffer.size(), " red fi");
+  buffer.insert(buffer.size(), "sh");
+
+  SECTION("replaces matches across pieces and counts them") {
+    REQUIRE(buffer.replace_all("fish", "cat") == 3);
+    REQUIRE(TextModel::FullTextOf(buffer) == "one cat, two cat, red cat");
+  }
+
+  SECTION("refers to a single stored replacement") {
+    buffer.replace_all("fish", "\n");
+    REQUIRE(buffer.line_count() == 4);
+    std::vector<std::string_view> chunks;
+    buffer.for_each_chunk(TextModel::Range{0, buffer.size()},
+        [&chunks](std::string_view chunk) {
+          if (chunk == "\n") {
+            chunks.push_back(chunk);
+          }
+        }
+    );
+    REQUIRE(chunks.size() == 3);
+    REQUIRE(chunks[0].data() == chunks[2].data());
+  }
+
+  SECTION("is a single undo step") {
+    buffer.replace_all("fish", "");
+    REQUIRE(TextModel::FullTextOf(buffer) == "one , two , red ");
+    buffer.undo();
+    REQUIRE(TextModel::FullTextOf(buffer) == "one fish, two fish, red fish");
+  }
+
+  SECTION("without matches changes nothing") {
+    const auto before = buffer.snapshot();
+    REQUIRE(buffer.replace_all("cat", "dog") == 0);
+    REQUIRE(buffer.snapshot() == before);
+  }
+}
+
+TEST_CASE("Lines of a text", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"first\nsecond\n"}};
+  buffer.insert(6, "inserted\nline\n");
+
+  SECTION("are counted from the line breaks") {
+    REQUIRE(buffer.line_count() == 5);
+  }
+
+  SECTION("start right after a line break") {
+    REQUIRE(buffer.offset_of_line(0) == 0);
+    REQUIRE(buffer.offset_of_line(1) == 6);
+    REQUIRE(buffer.offset_of_line(2) == 15);
+    REQUIRE(buffer.offset_of_line(3) == 20);
+    REQUIRE(buffer.offset_of_line(4) == buffer.size());
+    REQUIRE_THROWS_AS(buffer.offset_of_line(5), std::out_of_range);
+  }
+
+  SECTION("give the position of an offset") {
+    const auto position = buffer.position_of(17);
+    REQUIRE(position.line == 2);
+    REQUIRE(position.column == 2);
+    REQUIRE(buffer.position_of(buffer.size()).line == 4);
+    REQUIRE(buffer.position_of(5).column == 5);
+  }
+}
+
+TEST_CASE("Line positions follow random edits", "[unit]") {
+  std::mt19937 mt(20181101);
+  TextModel::TextBuffer buffer{TextModel::String{"a\nbb\nccc\n"}};
+  TextModel::String expected{"a\nbb\nccc\n"};
+  static const TextModel::String Insertions[] = {"x", "\n", "yy\nz", "\n\n"};
+  for (int edit = 0; edit < 500; ++edit) {
+    std::uniform_int_distribution<TextModel::Index> position(0, expected.size());
+    const auto start = position(mt);
+    if (edit % 4 == 0) {
+      const auto end = std::min(expected.size(), start + position(mt) % 5);
+      buffer.remove(TextModel::Range{start, end});
+      expected.erase(start, end - start);
+    }
+    else {
+      const auto& text = Insertions[edit % 4];
+      buffer.insert(start, text);
+      expected.insert(start, text);
+    }
+  }
+
+  TextModel::Index line{0};
+  TextModel::Index line_start{0};
+  for (TextModel::Index offset = 0; offset <= expected.size(); ++offset) {
+    const auto position = buffer.position_of(offset);
+    REQUIRE(position.line == line);
+    REQUIRE(position.column == offset - line_start);
+    REQUIRE(buffer.offset_of_line(line) == line_start);
+    if (offset < expected.size() && expected[offset] == '\n') {
+      ++line;
+      line_start = offset + 1;
+    }
+  }
+  REQUIRE(buffer.line_count() == line + 1);
+}
+
+TEST_CASE("Code point and UTF-16 offsets follow random edits", "[unit]") {
+  std::mt19937 mt(20181115);
+  const TextModel::String original{"h\xC3\xA9llo \xE2\x82\xAC\n"};
+  TextModel::TextBuffer buffer{original};
+  TextModel::String expected{original};
+  static const TextModel::String Insertions[] = {"x", "\xC3\xA9", "\xE2\x82\xAC\xE2\x82\xAC", "\xF0\x9F\x98\x80y"};
+  const auto boundaries = [&expected]() {
+    std::vector<TextModel::Index> result;
+    for (TextModel::Index offset = 0; offset <= expected.size(); ++offset) {
+      if (offset == expected.size() || !TextModel::IsContinuationByte(expected[offset])) {
+        result.push_back(offset);
+      }
+    }
+    return result;
+  };
+  for (int edit = 0; edit < 500; ++edit) {
+    const auto candidates = boundaries();
+    std::uniform_int_distribution<std::size_t> pick(0, candidates.size() - 1);
+    const auto first = pick(mt);
+    const auto start = candidates[first];
+    if (edit % 4 == 0) {
+      const auto end = candidates[std::min(candidates.size() - 1, first + pick(mt) % 5)];
+      buffer.remove(TextModel::Range{start, end});
+      expected.erase(start, end - start);
+    }
+    else {
+      const auto& text = Insertions[edit % 4];
+      buffer.insert(start, text);
+      expected.insert(start, text);
+    }
+  }
+  REQUIRE(TextModel::FullTextOf(buffer) == expected);
+
+  TextModel::Index code_point{0};
+  TextModel::Index unit{0};
+  for (TextModel::Index offset = 0; offset <= expected.size(); ++offset) {
+    REQUIRE(buffer.code_point_index_of(offset) == code_point);
+    if (offset == expected.size() || !TextModel::IsContinuationByte(expected[offset])) {
+      REQUIRE(buffer.utf16_index_of(offset) == unit);
+      REQUIRE(buffer.offset_of_code_point(code_point) == offset);
+      REQUIRE(buffer.offset_of_utf16_index(unit) == offset);
+    }
+    if (offset < expected.size() && !TextModel::IsContinuationByte(expected[offset])) {
+      const auto four_bytes = static_cast<unsigned char>(expected[offset]) >= 0xF0;
+      if (four_bytes) {
+        // The second unit of a surrogate pair maps back to its code point.
+        REQUIRE(buffer.offset_of_utf16_index(unit + 1) == offset);
+      }
+      ++code_point;
+      unit += four_bytes ? 2 : 1;
+    }
+  }
+  REQUIRE_THROWS_AS(buffer.code_point_index_of(expected.size() + 1), std::out_of_range);
+  REQUIRE_THROWS_AS(buffer.offset_of_code_point(code_point + 1), std::out_of_range);
+  REQUIRE_THROWS_AS(buffer.offset_of_utf16_index(unit + 1), std::out_of_range);
+}
+
+
+TEST_CASE("Edits keep the text well-formed UTF-8", "[unit]") {
+  TextModel::TextBuffer buffer{TextModel::String{"caf\xC3\xA9!"}};
+
+  SECTION("rejecting ill-formed text") {
+    REQUIRE_THROWS_AS(buffer.insert(0, "\xC3"), std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        buffer.apply({{TextModel::Range{0, 1}, "C"}, {TextModel::Range{2, 3}, "\xED\xA0\x80"}}),
+        std::invalid_argument
+    );
+    REQUIRE_THROWS_AS(buffer.replace_all("!", "\xFF"), std::invalid_argument);
+    REQUIRE(TextModel::FullTextOf(buffer) == "caf\xC3\xA9!");
+    REQUIRE(!buffer.can_undo());
+  }
+
+  SECTION("rejecting offsets inside a code point") {
+    REQUIRE_THROWS_AS(buffer.insert(4, "x"), std::invalid_argument);
+    REQUIRE_THROWS_AS(buffer.remove(TextModel::Range{4, 6}), std::invalid_argument);
+    REQUIRE_THROWS_AS(buffer.remove(TextModel::Range{0, 4}), std::invalid_argument);
+    buffer.remove(TextModel::Range{3, 5});
+    REQUIRE(TextModel::FullTextOf(buffer) == "caf!");
+  }
+
+  SECTION("taking any offset between the code points of an ill-formed original") {
+    TextModel::TextBuffer latin1{TextModel::String{"caf\xE9 \xA9\x80 \xC3\xA9\xA9"}};
+    latin1.insert(6, "x");
+    latin1.remove(TextModel::Range{5, 6});
+    latin1.remove(TextModel::Range{10, 11});
+    REQUIRE(TextModel::FullTextOf(latin1) == "caf\xE9 x\x80 \xC3\xA9");
+    REQUIRE_THROWS_AS(latin1.insert(9, "x"), std::invalid_argument);
+  }
+
+  SECTION("taking repaired text") {
+    buffer.insert(5, TextModel::RepairedUtf8("\xC3"));
+    REQUIRE(TextModel::FullTextOf(buffer) == "caf\xC3\xA9\xEF\xBF\xBD!");
+    REQUIRE(buffer.code_point_index_of(buffer.size()) == 6);
+  }
+}
+
+TEST_CASE("Offsets in an ill-formed original convert both ways", "[unit]") {
+  // Code points start at the offsets marked below: a stray continuation
+  // byte, a byte no sequence starts with, a three byte subpart of a four
+  // byte sequence, a lead its next byte does not continue and a well-formed
+  // four byte sequence.
+  const std::string pattern{"a\xC3\xA9\xA9z\xFF b\xF0\x9F\x98\xE0\x80\xF0\x9F\x98\x80"};
+  const std::string starts{"XX XXXXXX  XXX   "};
+  std::string original;
+  std::string code_point_starts;
+  // Long enough for sequences to run across the checkpoints of the index.
+  for (int i = 0; i < 100; ++i) {
+    original += pattern;
+    code_point_starts += starts;
+  }
+  TextModel::TextBuffer buffer{TextModel::String{original}};
+  buffer.insert(5 * pattern.size() + 4, "x\xF0\x9F\x98\x80");
+  code_point_starts.insert(5 * pattern.size() + 4, "XX   ");
+
+  TextModel::Index code_point{0};
+  TextModel::Index utf16_unit{0};
+  for (TextModel::Index offset = 0; offset < buffer.size(); ++offset) {
+    if (code_point_starts[offset] != 'X') {
+      REQUIRE_THROWS_AS(buffer.insert(offset, "x"), std::invalid_argument);
+      continue;
+    }
+    REQUIRE(buffer.code_point_index_of(offset) == code_point);
+    REQUIRE(buffer.offset_of_code_point(code_point) == offset);
+    REQUIRE(buffer.utf16_index_of(offset) == utf16_unit);
+    REQUIRE(buffer.offset_of_utf16_index(utf16_unit) == offset);
+    const auto four_bytes = buffer.text_of(TextModel::Range{offset, std::min(buffer.size(), offset + 4)});
+    ++code_point;
+    utf16_unit += four_bytes.size() == 4 && TextModel::IsValidUtf8(four_bytes) ? 2 : 1;
+  }
+  const auto repaired = TextModel::CountUtf8(TextModel::RepairedUtf8(TextModel::FullTextOf(buffer)));
+  REQUIRE(code_point == repaired.code_points);
+  REQUIRE(utf16_unit == repaired.utf16_units);
+  REQUIRE(buffer.code_point_index_of(buffer.size()) == repaired.code_points);
+  REQUIRE(buffer.utf16_index_of(buffer.size()) == repaired.utf16_units);
+}
+
 TEST_CASE("Benchmark text buffer", "![benchmark]") {
-  static constexpr size_t SufficientIteration{10000};
-  std::random_device rd;
-  std::mt19937 mt(rd());
+  static constexpr TextModel::Index SufficientIteration{10000};
+  // A fixed seed, so runs insert at the same positions and compare.
+  std::mt19937 mt{25};
   TextModel::TextBuffer buffer;
   BENCHMARK("insertion single characters at random position") {
-    for (auto loop_count = 0; loop_count < SufficientIteration; ++loop_count) {
+    for (TextModel::Index loop_count = 0; loop_count < SufficientIteration; ++loop_count) {
       std::uniform_int_distribution<TextModel::Index> dist(0, loop_count);
       const TextModel::Index where = dist(mt);
       buffer.insert(where, "ABC");
     }
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Benchmark typing", "![benchmark]") {
+  static constexpr TextModel::Index Keystrokes{10000};
+  static const TextModel::String Document(100000, 'x');
+
+  // Both type the same keys at the same place in a buffer made inside the
+  // benchmark, so they compare the same work: typing forward grows one span,
+  // while typing in front of the last key, as a cursor that stays put does,
+  // cannot coalesce and adds a piece per keystroke.
+  std::size_t pieces{0};
+  BENCHMARK("typing 10k characters forward, coalesced") {
+    TextModel::TextBuffer buffer{Document};
+    for (TextModel::Index i = 0; i < Keystrokes; ++i) {
+      buffer.insert(50000 + i, "a");
+    }
+    pieces = buffer.piece_count();
+  }
+  WARN("pieces after typing forward: " << pieces);
+
+  BENCHMARK("typing 10k characters backward, not coalesced") {
+    TextModel::TextBuffer buffer{Document};
+    for (TextModel::Index i = 0; i < Keystrokes; ++i) {
+      buffer.insert(50000, "a");
+    }
+    pieces = buffer.piece_count();
+  }
+  WARN("pieces after typing backward: " << pieces);
+}
@@ -1,144 +1,580 @@
 #include "TextModel/TextBuffer.h"
+#include "TextModel/Search.h"
+#include <stdexcept>
 
 namespace TextModel {
-  String TextBuffer::text_of(Span const& piece) const {
-    const auto& from{ piece.storage == Storage::Original
-        ? original_
-        : inserted_
-    };
+  namespace {
+    constexpr Index IndexingChunk{1 << 16};
+
+
+    bool EndsAt(Span const& piece, Storage storage, Index end) {
+      return piece.storage == storage
+          && piece.start_in_storage + piece.length == end;
+    }
+
+
+    // The pieces of the text with count sorted, non-overlapping ranges
+    // replaced, collected in a single pass over the existing pieces. Only the
+    // pieces a range starts or ends in get cut and re-measured.
+    template<class RangeOf, class ReplacementOf>
+      std::vector<Span> Replaced(
+          PieceTree const& tree, std::size_t count,
+          RangeOf range_of, ReplacementOf replacement_of,
+          SpanMeasure const& measure
+      ) {
+        std::vector<Span> pieces;
+        pieces.reserve(tree.pieces() + 2 * count);
+        std::size_t next{0};
+        bool replacement_emitted{false};
+        const auto emit_replacement = [&]() {
+          auto const& replacement = replacement_of(next);
+          if (!replacement_emitted && replacement.length > 0) {
+            pieces.push_back(replacement);
+          }
+          replacement_emitted = true;
+        };
+
+        Index offset{0};
+        ForEachPiece(tree, Range{0, tree.length()},
+            [&](Span const& piece) {
+              const auto piece_end = offset + piece.length;
+              auto at = offset;
+              while (at < piece_end) {
+                if (next < count && range_of(next).start <= at) {
+                  emit_replacement();
+                  const auto range_end = range_of(next).end;
+                  at = std::max(at, std::min(range_end, piece_end));
+                  if (at >= range_end) {
+                    ++next;
+                    replacement_emitted = false;
+                  }
+                }
+                else {
+                  const auto until = next < count
+                      ? std::min(range_of(next).start, piece_end)
+                      : piece_end
+                  ;
+                  pieces.push_back(at == offset && until == piece_end
+                      ? piece
+                      : measure(piece.storage, piece.start_in_storage + (at - offset), until - at)
+                  );
+                  at = until;
+                }
+              }
+              offset = piece_end;
+            }
+        );
+        for (; next < count; ++next) {
+          emit_replacement();
+          replacement_emitted = false;
+        }
+        return pieces;
+      }
+  } // anonymous namespace
+
+
+  std::string_view TextBuffer::view_of(Storage storage, Index start, Index length) const {
+    return storage == Storage::Original
+        ? original_.substr(start, length)
+        : inserted_.view(start, length)
+    ;
+  }
+
+
+  std::string_view TextBuffer::view_of(Span const& piece) const {
+    return view_of(piece.storage, piece.start_in_storage, piece.length);
+  }
+
+
+  LineBreaks const& TextBuffer::line_breaks_of(Storage storage) const {
+    return storage == Storage::Original
+        ? original_line_breaks_
+        : inserted_line_breaks_
+    ;
+  }
+
+
+  Utf8Index const& TextBuffer::utf8_index_of(Storage storage) const {
+    return storage == Storage::Original
+        ? original_utf8_
+        : inserted_utf8_
+    ;
+  }
 
-    return String(
-        from.begin() + piece.start_in_storage,
-        from.begin() + piece.start_in_storage + piece.length
+
+  Index TextBuffer::line_breaks_before(Storage storage, Index start) const {
+    return line_breaks_of(storage).count_before(start,
+        [this, storage](Index from, Index length) {
+          return view_of(storage, from, length);
+        }
     );
   }
 
 
-  TextBuffer::ListPosition TextBuffer::piece_at(Index index) const {
-    Index text_position{0};
-    auto piece = std::find_if(
-        pieces_.begin(), pieces_.end(),
-        [&text_position, index](const auto& piece) {
-          const auto end_of_piece = text_position + piece.length;
-          if (index < end_of_piece) {
-            return true;
-          }
-          else {
-            text_position = end_of_piece;
-            return false;
-          }
+  Utf8Counts TextBuffer::utf8_counts_before(Storage storage, Index start) const {
+    return utf8_index_of(storage).counts_before(start,
+        [this, storage](Index from, Index length) {
+          return view_of(storage, from, length);
         }
     );
-    return {piece, text_position};
   }
 
 
-  TextBuffer::MutListPosition TextBuffer::piece_at(Index index) {
-    Index text_position{0};
-    auto piece = std::find_if(
-        pieces_.begin(), pieces_.end(),
-        [&text_position, index](const auto& piece) {
-          const auto end_of_piece = text_position + piece.length;
-          if (index < end_of_piece) {
-            return true;
+  Span TextBuffer::span_of(Storage storage, Index start, Index length) const {
+    const auto counts = utf8_counts_before(storage, start + length) - utf8_counts_before(storage, start);
+    return Span{
+        storage, start, length,
+        line_breaks_before(storage, start + length) - line_breaks_before(storage, start),
+        counts.code_points,
+        counts.utf16_units
+    };
+  }
+
+
+  SpanMeasure TextBuffer::span_measure() const {
+    return [this](Storage storage, Index start, Index length) {
+      return span_of(storage, start, length);
+    };
+  }
+
+
+  void TextBuffer::check_consistency() const {
+    if (!IsConsistent(pieces_)) {
+      throw std::logic_error("TextBuffer: cached piece measures are out of date");
+    }
+
+    Index total_length{0};
+    ForEachPiece(pieces_, Range{0, pieces_.length()},
+        [this, &total_length](Span const& piece) {
+          const auto storage_size = piece.storage == Storage::Original
+              ? original_.size()
+              : inserted_.size()
+          ;
+          if (piece.start_in_storage + piece.length > storage_size) {
+            throw std::logic_error("TextBuffer: span points outside of its storage");
           }
-          else {
-            text_position = end_of_piece;
-            return false;
+          const auto measured = span_of(piece.storage, piece.start_in_storage, piece.length);
+          if (piece.line_breaks != measured.line_breaks) {
+            throw std::logic_error("TextBuffer: span has a stale line break count");
           }
+          if (piece.code_points != measured.code_points || piece.utf16_units != measured.utf16_units) {
+            throw std::logic_error("TextBuffer: span has stale UTF-8 counts");
+          }
+          total_length += piece.length;
         }
     );
-    return {piece, text_position};
+    if (total_length != size()) {
+      throw std::logic_error("TextBuffer: cached size differs from the sum of spans");
+    }
   }
 
 
-  TextBuffer::TextBuffer(String str)
-  : original_{std::move(str)}
-  , pieces_{Span{Storage::Original, 0, original_.size()}} {}
+  void TextBuffer::adopt_original(std::shared_ptr<const void> owner, std::string_view original) {
+    original_owner_ = std::move(owner);
+    original_ = original;
+    if (!original_.empty()) {
+      // The original piece needs the counts of the whole text, so both
+      // indexes are built here, a chunk at a time, so that the pages of a
+      // mapped file are read in once.
+      Index line_breaks{0};
+      Utf8Counts counts{0, 0};
+      for (Index start = 0; start < original_.size(); start += IndexingChunk) {
+        const auto chunk = original_.substr(start, IndexingChunk);
+        line_breaks += original_line_breaks_.append(chunk, start);
+        counts = counts + original_utf8_.append(chunk, start);
+      }
+      pieces_ = PieceTree{{}, Span{
+          Storage::Original, 0, original_.size(),
+          line_breaks, counts.code_points, counts.utf16_units
+      }, {}};
+    }
+  }
 
 
-  void TextBuffer::insert(Index index, String text) {
-    const auto append_index = inserted_.size();
-    inserted_ += text;
-    auto piece = piece_at(index);
-    if (piece.first == pieces_.end()) {
-      pieces_.emplace_back(Storage::Inserted, append_index, text.size());
-    }
-    else {
-      auto first_split{piece.first};
-      const auto relative_position{index - piece.second};
-      if (relative_position > 0) {
-        auto second_split{Generics::InsertAfter(pieces_, first_split, *first_split)};
-        first_split->length = relative_position;
-        second_split->start_in_storage += relative_position;
-        second_split->length -= relative_position;
+  Span TextBuffer::appended(std::string_view text) {
+    const auto append_index = inserted_.append(text);
+    const auto line_breaks = inserted_line_breaks_.append(text, append_index);
+    const auto counts = inserted_utf8_.append(text, append_index);
+    return Span{
+        Storage::Inserted, append_index, text.size(),
+        line_breaks, counts.code_points, counts.utf16_units
+    };
+  }
+
+
+  void TextBuffer::check_boundary(Index offset) const {
+    if (offset > 0 && offset < size()) {
+      const auto found = PieceAt(pieces_, offset);
+      const auto byte = view_of(found.piece.storage, found.piece.start_in_storage + (offset - found.offset), 1);
+      if (!IsContinuationByte(byte.front())) {
+        return;
+      }
+      // Continuation bytes of the original may start code points of their
+      // own when it is ill-formed.
+      const auto start = offset - std::min<Index>(offset, 3);
+      const auto around = text_of(Range{start, std::min(size(), offset + 3)});
+      if (IsInsideCodePoint(around, offset - start)) {
+        throw std::invalid_argument("TextBuffer: offset is inside of a code point");
       }
-      Generics::InsertAfter(pieces_, first_split, Span{Storage::Inserted, append_index, text.size()});
     }
   }
 
 
-  void TextBuffer::remove(Range const& range) {
-    auto pieces_begin{piece_at(range.start)};
-    auto pieces_end{piece_at(range.end)};
+  Utf8Counts TextBuffer::counts_before(Index offset) const {
+    if (offset == size()) {
+      return {pieces_.code_points(), pieces_.utf16_units()};
+    }
+    const auto found = PieceAt(pieces_, offset);
+    auto const& piece = found.piece;
+    return Utf8Counts{found.code_points_before, found.utf16_units_before}
+        + utf8_counts_before(piece.storage, piece.start_in_storage + (offset - found.offset))
+        - utf8_counts_before(piece.storage, piece.start_in_storage)
+    ;
+  }
+
+
+  TextBuffer::TextBuffer(String str) {
+    auto owner = std::make_shared<const String>(std::move(str));
+    const std::string_view original{*owner};
+    adopt_original(std::move(owner), original);
+  }
+
+
+  TextBuffer::TextBuffer(MappedFile file) {
+    auto owner = std::make_shared<const MappedFile>(std::move(file));
+    const auto original = owner->text();
+    adopt_original(std::move(owner), original);
+  }
+
+
+  void TextBuffer::commit(PieceTree pieces) {
+    undo_.push_back(std::move(pieces_));
+    redo_.clear();
+    typing_ = false;
+    pieces_ = std::move(pieces);
+
+#if defined(TEXTMODEL_CONSISTENCY_CHECKS)
+    check_consistency();
+#endif
+  }
+
+
+  void TextBuffer::amend(PieceTree pieces) {
+    pieces_ = std::move(pieces);
+
+#if defined(TEXTMODEL_CONSISTENCY_CHECKS)
+    check_consistency();
+#endif
+  }
 
-    if (pieces_begin.first == pieces_end.first) {
-      pieces_begin.first = pieces_.insert(pieces_begin.first, *pieces_begin.first);
-      pieces_begin.first->length = range.start - pieces_begin.second;
-      pieces_end.first->start_in_storage += range.end - pieces_begin.second;
-      pieces_end.first->length -= range.end - pieces_begin.second;
+
+  void TextBuffer::insert(Index index, std::string_view text) {
+    if (text.empty()) {
+      return;
     }
-    else {
-      if (range.start - pieces_begin.second > 0) {
-        pieces_begin.first->length = range.start - pieces_begin.second;
-        pieces_begin.first++;
-        pieces_begin.second = 0;
+    if (!IsValidUtf8(text)) {
+      throw std::invalid_argument("TextBuffer: text is not valid UTF-8");
+    }
+    check_boundary(index);
+
+    const auto piece = appended(text);
+    const auto [before, after] = SplitAt(pieces_, index, span_measure());
+
+    // Typing right after the previous insertion grows its span instead of
+    // adding a new piece for every keystroke, and joins its undo step when
+    // that insertion was the last step.
+    if (!before.empty()
+        && EndsAt(PieceAt(before, before.length() - 1).piece, Storage::Inserted, piece.start_in_storage)) {
+      const auto [rest, last] = SplitLast(before);
+      auto pieces = Joined(rest, Span{
+          Storage::Inserted,
+          last.start_in_storage,
+          last.length + piece.length,
+          last.line_breaks + piece.line_breaks,
+          last.code_points + piece.code_points,
+          last.utf16_units + piece.utf16_units
+      }, after);
+      if (typing_) {
+        amend(std::move(pieces));
+      }
+      else {
+        commit(std::move(pieces));
       }
-      pieces_.erase(pieces_begin.first, pieces_end.first);
+    }
+    else {
+      commit(Joined(before, piece, after));
+    }
+    typing_ = true;
+  }
+
 
-      const auto relative_position{range.end - pieces_end.second};
-      pieces_end.first->length -= relative_position;
-      pieces_end.first->start_in_storage += relative_position;
+  void TextBuffer::remove(Range const& range) {
+    if (range.end <= range.start) {
+      return;
     }
+    check_boundary(range.start);
+    check_boundary(range.end);
+
+    const auto measure = span_measure();
+    const auto [before, rest] = SplitAt(pieces_, range.start, measure);
+    const auto [removed, after] = SplitAt(rest, range.end - range.start, measure);
+    commit(Concatenated(before, after));
   }
 
 
   String TextBuffer::text_of(Range const& range) const {
-    auto pieces_begin{piece_at(range.start)};
-    auto pieces_end{piece_at(range.end)};
-
     String result;
-    const auto relative_start = range.start - pieces_begin.second;
-    if (relative_start > 0) {
-      const auto first_bit{text_of(*(pieces_begin.first))};
-      const auto piece_length = pieces_begin.first == pieces_end.first
-          ? range.end - pieces_end.second
-          : first_bit.size()
-      ;
+    text_of(range, result);
+    return result;
+  }
 
-      result = String(
-          first_bit.begin() + relative_start,
-          first_bit.begin() + piece_length
-      );
-      pieces_begin.first++;
-      pieces_begin.second = 0;
-    }
-    return std::accumulate(
-        pieces_begin.first, pieces_end.first,
-        result,
-        [this](String const& lhs, Span const& rhs) {
-          return lhs + text_of(rhs);
+
+  void TextBuffer::for_each_chunk(Range const& range, ChunkVisitor const& visitor) const {
+    ForEachPiece(pieces_, range,
+        [this, &visitor](Span const& piece) {
+          visitor(view_of(piece));
         }
     );
   }
 
+
   Index TextBuffer::size() const {
-    return std::accumulate(
-        pieces_.begin(), pieces_.end(), Index{0},
-        [](Index lhs, Span const& rhs) {
-          return lhs + rhs.length;
+    return pieces_.length();
+  }
+
+
+  void TextBuffer::apply(std::vector<Edit> const& edits) {
+    for (std::size_t i = 0; i < edits.size(); ++i) {
+      if (edits[i].range.end < edits[i].range.start
+          || (i > 0 && edits[i].range.start < edits[i - 1].range.end)) {
+        throw std::invalid_argument("TextBuffer: edits must be sorted and must not overlap");
+      }
+      if (!IsValidUtf8(edits[i].text)) {
+        throw std::invalid_argument("TextBuffer: text is not valid UTF-8");
+      }
+      check_boundary(edits[i].range.start);
+      check_boundary(edits[i].range.end);
+    }
+    if (edits.empty()) {
+      return;
+    }
+
+    std::vector<Span> replacements;
+    replacements.reserve(edits.size());
+    for (auto const& edit : edits) {
+      replacements.push_back(appended(edit.text));
+    }
+
+    commit(PieceTree{Replaced(
+        pieces_, edits.size(),
+        [&edits](std::size_t i) { return edits[i].range; },
+        [&replacements](std::size_t i) -> Span const& { return replacements[i]; },
+        span_measure()
+    )});
+  }
+
+
+  Index TextBuffer::replace_all(std::string_view pattern, std::string_view replacement) {
+    // A well-formed pattern only matches whole code points.
+    if (!IsValidUtf8(pattern) || !IsValidUtf8(replacement)) {
+      throw std::invalid_argument("TextBuffer: text is not valid UTF-8");
+    }
+    const auto matches = FindAll(*this, pattern);
+    if (matches.empty()) {
+      return 0;
+    }
+
+    const auto replacement_span = appended(replacement);
+
+    commit(PieceTree{Replaced(
+        pieces_, matches.size(),
+        [&matches, &pattern](std::size_t i) {
+          return Range{matches[i], matches[i] + pattern.size()};
+        },
+        [&replacement_span](std::size_t) -> Span const& { return replacement_span; },
+        span_measure()
+    )});
+    return matches.size();
+  }
+
+
+  TextBuffer::Snapshot::Snapshot(
+      PieceTree pieces,
+      std::shared_ptr<const void> original_owner, std::string_view original,
+      std::shared_ptr<const AppendStorage::Blocks> inserted
+  )
+  : pieces_{std::move(pieces)}
+  , original_owner_{std::move(original_owner)}
+  , original_{original}
+  , inserted_{std::move(inserted)} {}
+
+
+  std::string_view TextBuffer::Snapshot::view_of(Span const& piece) const {
+    return piece.storage == Storage::Original
+        ? original_.substr(piece.start_in_storage, piece.length)
+        : AppendStorage::ViewOf(*inserted_, piece.start_in_storage, piece.length)
+    ;
+  }
+
+
+  String TextBuffer::Snapshot::text_of(Range const& range) const {
+    String result;
+    text_of(range, result);
+    return result;
+  }
+
+
+  void TextBuffer::Snapshot::for_each_chunk(Range const& range, ChunkVisitor const& visitor) const {
+    ForEachPiece(pieces_, range,
+        [this, &visitor](Span const& piece) {
+          visitor(view_of(piece));
         }
     );
   }
 
-} // TextModel
\ No newline at end of file
+
+  TextBuffer::Snapshot TextBuffer::snapshot() const {
+    return Snapshot{pieces_, original_owner_, original_, inserted_.blocks()};
+  }
+
+
+  void TextBuffer::restore(Snapshot const& snapshot) {
+    if (snapshot.pieces_ != pieces_) {
+      commit(snapshot.pieces_);
+    }
+  }
+
+
+  bool TextBuffer::undo() {
+    if (undo_.empty()) {
+      return false;
+    }
+    redo_.push_back(std::move(pieces_));
+    pieces_ = std::move(undo_.back());
+    undo_.pop_back();
+    typing_ = false;
+    return true;
+  }
+
+
+  bool TextBuffer::redo() {
+    if (redo_.empty()) {
+      return false;
+    }
+    undo_.push_back(std::move(pieces_));
+    pieces_ = std::move(redo_.back());
+    redo_.pop_back();
+    typing_ = false;
+    return true;
+  }
+
+
+  void TextBuffer::clear_history() {
+    undo_.clear();
+    redo_.clear();
+    typing_ = false;
+  }
+
+
+  Index TextBuffer::line_count() const {
+    return pieces_.line_breaks() + 1;
+  }
+
+
+  Index TextBuffer::offset_of_line(Index line) const {
+    if (line >= line_count()) {
+      throw std::out_of_range("TextBuffer: line is past the end of the text");
+    }
+    else if (line == 0) {
+      return 0;
+    }
+
+    const auto found = PieceWithLineBreak(pieces_, line - 1);
+    auto const& piece = found.piece;
+    const auto line_break = line_breaks_of(piece.storage).offset_of(
+        line_breaks_before(piece.storage, piece.start_in_storage)
+            + (line - 1 - found.line_breaks_before),
+        [this, &piece](Index from, Index length) {
+          return view_of(piece.storage, from, length);
+        }
+    );
+    return found.offset + (line_break - piece.start_in_storage) + 1;
+  }
+
+
+  Position TextBuffer::position_of(Index offset) const {
+    if (offset > size()) {
+      throw std::out_of_range("TextBuffer: offset is past the end of the text");
+    }
+
+    Index line{pieces_.line_breaks()};
+    if (offset < size()) {
+      const auto found = PieceAt(pieces_, offset);
+      auto const& piece = found.piece;
+      const auto start = piece.start_in_storage;
+      line = found.line_breaks_before
+          + line_breaks_before(piece.storage, start + (offset - found.offset))
+          - line_breaks_before(piece.storage, start)
+      ;
+    }
+    return {line, offset - offset_of_line(line)};
+  }
+
+
+  Index TextBuffer::code_point_index_of(Index offset) const {
+    if (offset > size()) {
+      throw std::out_of_range("TextBuffer: offset is past the end of the text");
+    }
+    return counts_before(offset).code_points;
+  }
+
+
+  Index TextBuffer::offset_of_code_point(Index code_point) const {
+    if (code_point > pieces_.code_points()) {
+      throw std::out_of_range("TextBuffer: code point is past the end of the text");
+    }
+    else if (code_point == pieces_.code_points()) {
+      return size();
+    }
+
+    const auto found = PieceWithCodePoint(pieces_, code_point);
+    auto const& piece = found.piece;
+    const auto in_storage = utf8_index_of(piece.storage).offset_of_code_point(
+        utf8_counts_before(piece.storage, piece.start_in_storage).code_points
+            + (code_point - found.code_points_before),
+        [this, &piece](Index from, Index length) {
+          return view_of(piece.storage, from, length);
+        }
+    );
+    return found.offset + (in_storage - piece.start_in_storage);
+  }
+
+
+  Index TextBuffer::utf16_index_of(Index offset) const {
+    if (offset > size()) {
+      throw std::out_of_range("TextBuffer: offset is past the end of the text");
+    }
+    return counts_before(offset).utf16_units;
+  }
+
+
+  Index TextBuffer::offset_of_utf16_index(Index unit) const {
+    if (unit > pieces_.utf16_units()) {
+      throw std::out_of_range("TextBuffer: UTF-16 unit is past the end of the text");
+    }
+    else if (unit == pieces_.utf16_units()) {
+      return size();
+    }
+
+    const auto found = PieceWithUtf16Unit(pieces_, unit);
+    auto const& piece = found.piece;
+    const auto in_storage = utf8_index_of(piece.storage).offset_of_utf16_unit(
+        utf8_counts_before(piece.storage, piece.start_in_storage).utf16_units
+            + (unit - found.utf16_units_before),
+        [this, &piece](Index from, Index length) {
+          return view_of(piece.storage, from, length);
+        }
+    );
+    return found.offset + (in_storage - piece.start_in_storage);
+  }
+} // TextModel
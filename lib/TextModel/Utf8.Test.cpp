@@ -0,0 +1,135 @@
+#include "catch2/catch.hpp"
+#include "TextModel/Utf8.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+  // One, two, three and four byte sequences.
+  const std::string Mixed{"a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"};
+
+  TextModel::Index BruteForceCodePoints(std::string_view text) {
+    TextModel::Index count{0};
+    for (const auto byte : text) {
+      count += TextModel::IsContinuationByte(byte) ? 0 : 1;
+    }
+    return count;
+  }
+} // anonymous namespace
+
+
+TEST_CASE("Counting UTF-8 text", "[unit]") {
+  SECTION("counts code points and UTF-16 units of every sequence length") {
+    const auto counts = TextModel::CountUtf8(Mixed);
+    REQUIRE(counts.code_points == 4);
+    REQUIRE(counts.utf16_units == 5);
+  }
+
+  SECTION("gives the same counts with and without vector instructions") {
+    std::string text;
+    for (int i = 0; i < 100; ++i) {
+      text += Mixed;
+    }
+    for (TextModel::Index length = 0; length < 200; ++length) {
+      // Cut sequences at either end are ill-formed, and count as the
+      // replacement characters they get.
+      const auto part = std::string_view{text}.substr(length % 10, length);
+      REQUIRE(TextModel::CountUtf8(part).code_points == BruteForceCodePoints(TextModel::RepairedUtf8(part)));
+    }
+    REQUIRE(TextModel::CountUtf8(text).utf16_units == 500);
+  }
+}
+
+
+TEST_CASE("Validating UTF-8", "[unit]") {
+  const std::string ascii(100, 'x');
+
+  SECTION("accepts well-formed text") {
+    REQUIRE(TextModel::IsValidUtf8(""));
+    REQUIRE(TextModel::IsValidUtf8(ascii));
+    REQUIRE(TextModel::IsValidUtf8(ascii + Mixed + ascii));
+    REQUIRE(TextModel::IsValidUtf8("\xF4\x8F\xBF\xBF"));
+  }
+
+  SECTION("rejects ill-formed sequences, also after long runs of ASCII") {
+    for (const std::string bad : {
+        "\x80", "\xC0\x80", "\xC1\xBF", "\xE0\x9F\xBF", "\xED\xA0\x80",
+        "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xE2\x82", "\xFF"
+    }) {
+      REQUIRE(!TextModel::IsValidUtf8(bad));
+      REQUIRE(!TextModel::IsValidUtf8(ascii + bad + ascii));
+    }
+  }
+
+  SECTION("repairs every maximal ill-formed subpart with one replacement character") {
+    REQUIRE(TextModel::RepairedUtf8(Mixed) == Mixed);
+    REQUIRE(TextModel::RepairedUtf8("a\xF0\x9F\x98" "b") == "a\xEF\xBF\xBD" "b");
+    REQUIRE(TextModel::RepairedUtf8("\xC0\x80") == "\xEF\xBF\xBD\xEF\xBF\xBD");
+    REQUIRE(TextModel::RepairedUtf8("\xE2\x82\xE2\x82\xAC") == "\xEF\xBF\xBD\xE2\x82\xAC");
+  }
+
+  SECTION("counts every maximal ill-formed subpart as its replacement") {
+    for (auto const& bad : std::vector<std::string>{
+        "a\xC3\xA9\xA9z", "a\xFF b", "\xF0\x9F\x98" "b", "\xC0\x80", "\xE0\x80\xF0\x9F\x98\x80",
+        ascii + "\xE2\x82" + ascii + "\xBF\xBF" + ascii
+    }) {
+      const auto counts = TextModel::CountUtf8(bad);
+      const auto repaired = TextModel::CountUtf8(TextModel::RepairedUtf8(bad));
+      REQUIRE(counts.code_points == repaired.code_points);
+      REQUIRE(counts.utf16_units == repaired.utf16_units);
+    }
+  }
+}
+
+
+TEST_CASE("Indexing the code points of a storage", "[unit]") {
+  std::string storage;
+  // Whether a byte was skipped rather than appended.
+  std::vector<bool> skipped;
+  TextModel::Utf8Index index;
+  const auto view = [&storage](TextModel::Index start, TextModel::Index length) {
+    return std::string_view{storage}.substr(start, length);
+  };
+
+  std::mt19937 generator{15};
+  for (int i = 0; i < 200; ++i) {
+    static const std::string Sequences[]{"a", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80"};
+    std::string text;
+    for (auto n = generator() % 20; n > 0; --n) {
+      text += Sequences[generator() % 4];
+    }
+    // Now and then skip to the next stride like a new storage block does,
+    // filling the gap with bytes that count as nothing.
+    if (i % 50 == 49) {
+      storage.resize((storage.size() / TextModel::Utf8Index::Stride + 1) * TextModel::Utf8Index::Stride, '\x80');
+      skipped.resize(storage.size(), true);
+    }
+    const auto counts = index.append(text, storage.size());
+    REQUIRE(counts.code_points == BruteForceCodePoints(text));
+    storage += text;
+    skipped.resize(storage.size(), false);
+  }
+
+  SECTION("counts any prefix") {
+    TextModel::Index code_points{0};
+    for (TextModel::Index offset = 0; offset <= storage.size(); ++offset) {
+      if (offset > 0 && !TextModel::IsContinuationByte(storage[offset - 1])) {
+        ++code_points;
+      }
+      if (offset % 7 == 0 && (offset == 0 || !skipped[offset - 1])) {
+        REQUIRE(index.counts_before(offset, view).code_points == code_points);
+      }
+    }
+  }
+
+  SECTION("finds the offset of every code point") {
+    TextModel::Index code_point{0};
+    for (TextModel::Index offset = 0; offset < storage.size(); ++offset) {
+      if (!TextModel::IsContinuationByte(storage[offset])) {
+        REQUIRE(index.offset_of_code_point(code_point, view) == offset);
+        REQUIRE(index.offset_of_utf16_unit(index.counts_before(offset, view).utf16_units, view) == offset);
+        ++code_point;
+      }
+    }
+  }
+}
@@ -0,0 +1,328 @@
+#include "TextModel/Utf8.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace TextModel {
+  namespace {
+    // The state after lead, with nothing pending when lead does not start a
+    // sequence of several bytes.
+    Utf8State StateAfterLead(unsigned char lead) {
+      Utf8State state;
+      if (lead >= 0xC2 && lead <= 0xDF) {
+        state.pending = 1;
+      }
+      else if (lead >= 0xE0 && lead <= 0xEF) {
+        state.pending = 2;
+        if (lead == 0xE0) {
+          state.low = 0xA0;
+        }
+        else if (lead == 0xED) {
+          state.high = 0x9F;
+        }
+      }
+      else if (lead >= 0xF0 && lead <= 0xF4) {
+        state.pending = 3;
+        state.four_byte = true;
+        if (lead == 0xF0) {
+          state.low = 0x90;
+        }
+        else if (lead == 0xF4) {
+          state.high = 0x8F;
+        }
+      }
+      return state;
+    }
+
+
+    // Takes byte as the next continuation byte of the sequence in progress
+    // when it can be one.
+    bool Continued(Utf8State& state, unsigned char byte) {
+      if (state.pending == 0 || byte < state.low || byte > state.high) {
+        return false;
+      }
+      --state.pending;
+      state.low = 0x80;
+      state.high = 0xBF;
+      return true;
+    }
+
+
+    // Length of the well-formed sequence at the start of text, or, when it is
+    // ill-formed, the negated length of its maximal ill-formed subpart.
+    int SequenceAt(unsigned char const* begin, unsigned char const* end) {
+      const auto lead = *begin;
+      if (lead < 0x80) {
+        return 1;
+      }
+
+      auto state = StateAfterLead(lead);
+      if (state.pending == 0) {
+        return -1;
+      }
+      for (int i = 1;; ++i) {
+        if (begin + i == end || !Continued(state, begin[i])) {
+          return -i;
+        }
+        else if (state.pending == 0) {
+          return i + 1;
+        }
+      }
+    }
+
+
+    // Counts byte the way a scan with SequenceAt would: a sequence or
+    // subpart as it starts, and the second UTF-16 unit of a four byte
+    // sequence as it ends.
+    void Count(unsigned char byte, Utf8State& state, Utf8Counts& counts) {
+      if (Continued(state, byte)) {
+        if (state.pending == 0 && state.four_byte) {
+          ++counts.utf16_units;
+        }
+        return;
+      }
+      ++counts.code_points;
+      ++counts.utf16_units;
+      state = StateAfterLead(byte);
+    }
+
+
+#if defined(__SSE2__)
+    __m128i AtLeast(__m128i bytes, unsigned char bound) {
+      return _mm_cmpeq_epi8(_mm_max_epu8(bytes, _mm_set1_epi8(static_cast<char>(bound))), bytes);
+    }
+
+    __m128i AtMost(__m128i bytes, unsigned char bound) {
+      return _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(static_cast<char>(bound))), bytes);
+    }
+
+    __m128i Equal(__m128i bytes, unsigned char value) {
+      return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(value)));
+    }
+
+
+    // Counts the text from current, which is outside of any sequence, 16
+    // bytes at a time for as long as they are well-formed, and returns where
+    // it stopped, with state set for a sequence running on from there. In a
+    // well-formed vector the bytes that have to be continuation bytes, as the
+    // leads up to three bytes before them ask for them, are exactly the
+    // continuation bytes, no byte is one that is never well-formed and no
+    // second byte is out of the range its lead allows. Four byte sequences
+    // are counted as they start, and taken back when they do not end in the
+    // vectors counted.
+    unsigned char const* CountedVectors(
+        unsigned char const* current, unsigned char const* end,
+        Utf8State& state, Utf8Counts& counts
+    ) {
+      auto const* const start = current;
+      auto previous = _mm_setzero_si128();
+      for (; end - current >= 16; current += 16) {
+        const auto block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(current));
+        if (_mm_movemask_epi8(_mm_or_si128(block, previous)) == 0) {
+          counts = counts + Utf8Counts{16, 16};
+          previous = block;
+          continue;
+        }
+
+        const auto back_one = _mm_or_si128(_mm_slli_si128(block, 1), _mm_srli_si128(previous, 15));
+        const auto back_two = _mm_or_si128(_mm_slli_si128(block, 2), _mm_srli_si128(previous, 14));
+        const auto back_three = _mm_or_si128(_mm_slli_si128(block, 3), _mm_srli_si128(previous, 13));
+        const auto continuation = _mm_cmplt_epi8(block, _mm_set1_epi8(-64));
+        const auto wanted = _mm_or_si128(
+            _mm_or_si128(AtLeast(back_one, 0xC0), AtLeast(back_two, 0xE0)),
+            AtLeast(back_three, 0xF0)
+        );
+        const auto ill_formed = _mm_or_si128(
+            _mm_or_si128(
+                _mm_xor_si128(continuation, wanted),
+                _mm_or_si128(Equal(_mm_and_si128(block, _mm_set1_epi8(-2)), 0xC0), AtLeast(block, 0xF5))
+            ),
+            _mm_or_si128(
+                _mm_or_si128(
+                    _mm_and_si128(Equal(back_one, 0xE0), AtMost(block, 0x9F)),
+                    _mm_and_si128(Equal(back_one, 0xED), AtLeast(block, 0xA0))
+                ),
+                _mm_or_si128(
+                    _mm_and_si128(Equal(back_one, 0xF0), AtMost(block, 0x8F)),
+                    _mm_and_si128(Equal(back_one, 0xF4), AtLeast(block, 0x90))
+                )
+            )
+        );
+        if (_mm_movemask_epi8(ill_formed) != 0) {
+          break;
+        }
+        const auto leads = static_cast<Index>(__builtin_popcount(
+            ~static_cast<unsigned>(_mm_movemask_epi8(continuation)) & 0xFFFF
+        ));
+        const auto fours = static_cast<Index>(__builtin_popcount(
+            static_cast<unsigned>(_mm_movemask_epi8(AtLeast(block, 0xF0)))
+        ));
+        counts = counts + Utf8Counts{leads, leads + fours};
+        previous = block;
+      }
+
+      for (std::ptrdiff_t back = 1; back <= 3 && current - back >= start; ++back) {
+        if (!IsContinuationByte(static_cast<char>(current[-back]))) {
+          auto running_on = StateAfterLead(current[-back]);
+          if (running_on.pending >= back) {
+            for (auto i = back - 1; i > 0; --i) {
+              Continued(running_on, current[-i]);
+            }
+            state = running_on;
+            counts.utf16_units -= state.four_byte ? 1 : 0;
+          }
+          break;
+        }
+      }
+      return current;
+    }
+#endif
+  } // anonymous namespace
+
+
+  Utf8Counts CountUtf8(std::string_view text) {
+    Utf8State state;
+    return CountUtf8(text, state);
+  }
+
+
+  Utf8Counts CountUtf8(std::string_view text, Utf8State& state) {
+    auto const* const begin = reinterpret_cast<unsigned char const*>(text.data());
+    auto const* const end = begin + text.size();
+    auto const* current = begin;
+    Utf8Counts counts{0, 0};
+
+    while (current < end) {
+#if defined(__SSE2__)
+      if (state.pending == 0) {
+        current = CountedVectors(current, end, state, counts);
+      }
+#endif
+      // Byte by byte over what stopped the vectors, and on while a sequence
+      // runs.
+      for (auto left = std::min<std::ptrdiff_t>(16, end - current); left > 0 || (current < end && state.pending > 0); --left) {
+        Count(*current++, state, counts);
+      }
+    }
+    return counts;
+  }
+
+
+  // Skips ASCII a vector at a time and checks the sequences one by one only
+  // where a vector holds anything else.
+  bool IsValidUtf8(std::string_view text) {
+    auto const* const begin = reinterpret_cast<unsigned char const*>(text.data());
+    auto const* const end = begin + text.size();
+    auto const* current = begin;
+
+    while (current < end) {
+#if defined(__AVX2__)
+      if (end - current >= 32
+          && _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(current))) == 0) {
+        current += 32;
+        continue;
+      }
+#endif
+#if defined(__SSE2__)
+      if (end - current >= 16
+          && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(current))) == 0) {
+        current += 16;
+        continue;
+      }
+#endif
+      const auto length = SequenceAt(current, end);
+      if (length < 0) {
+        return false;
+      }
+      current += length;
+    }
+    return true;
+  }
+
+
+  String RepairedUtf8(std::string_view text) {
+    static constexpr std::string_view Replacement{"\xEF\xBF\xBD"};
+    auto const* const begin = reinterpret_cast<unsigned char const*>(text.data());
+    auto const* const end = begin + text.size();
+
+    String result;
+    result.reserve(text.size());
+    auto const* valid_from = begin;
+    auto const* current = begin;
+    while (current < end) {
+      const auto length = SequenceAt(current, end);
+      if (length > 0) {
+        current += length;
+      }
+      else {
+        result.append(text.substr(static_cast<Index>(valid_from - begin), static_cast<Index>(current - valid_from)));
+        result.append(Replacement);
+        current -= length;
+        valid_from = current;
+      }
+    }
+    result.append(text.substr(static_cast<Index>(valid_from - begin)));
+    return result;
+  }
+
+
+  bool IsInsideCodePoint(std::string_view text, Index offset) {
+    if (offset >= text.size() || !IsContinuationByte(text[offset])) {
+      return false;
+    }
+    auto const* const begin = reinterpret_cast<unsigned char const*>(text.data());
+    for (Index start = offset; start-- > 0 && offset - start < 4;) {
+      if (!IsContinuationByte(text[start])) {
+        return std::abs(SequenceAt(begin + start, begin + text.size())) > static_cast<int>(offset - start);
+      }
+    }
+    return false;
+  }
+
+
+  Index Utf8Index::OffsetIn(
+      std::string_view window, Index start, Checkpoint const& checkpoint, Index n, bool utf16
+  ) {
+    auto counts = checkpoint.counts;
+    auto state = checkpoint.state;
+    for (Index i = 0; i < window.size(); ++i) {
+      const auto code_points = counts.code_points;
+      Count(static_cast<unsigned char>(window[i]), state, counts);
+      if ((utf16 ? counts.utf16_units : counts.code_points) > n) {
+        // Only the last byte of a four byte sequence counts without
+        // starting a code point.
+        return counts.code_points == code_points ? start + i - 3 : start + i;
+      }
+    }
+    return start + window.size();
+  }
+
+
+  Utf8Counts Utf8Index::append(std::string_view text, Index offset) {
+    if (offset != end_) {
+      state_ = Utf8State{};
+    }
+    while (checkpoints_.size() * Stride <= offset) {
+      checkpoints_.push_back({total_, state_});
+    }
+    end_ = offset;
+
+    const auto before = total_;
+    Index done{0};
+    while (done < text.size()) {
+      const auto next_checkpoint = (end_ / Stride + 1) * Stride;
+      const auto length = std::min(text.size() - done, next_checkpoint - end_);
+      total_ = total_ + CountUtf8(text.substr(done, length), state_);
+      done += length;
+      end_ += length;
+      if (end_ == next_checkpoint) {
+        checkpoints_.push_back({total_, state_});
+      }
+    }
+    return total_ - before;
+  }
+} // TextModel
@@ -0,0 +1,178 @@
+#include "Allocations.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace Benchmark {
+  namespace {
+    std::atomic<std::size_t> count_{0};
+    std::atomic<std::size_t> bytes_{0};
+    std::atomic<std::size_t> live_bytes_{0};
+    std::atomic<std::size_t> peak_live_bytes_{0};
+
+    std::size_t UsableSize(void* pointer) noexcept {
+#if defined(__APPLE__)
+      return malloc_size(pointer);
+#else
+      return malloc_usable_size(pointer);
+#endif
+    }
+
+    // Every operator new and delete of the program ends up here, the aligned
+    // ones included, as they all take their memory from malloc or
+    // posix_memalign, whose blocks free takes alike.
+    void* Counted(void* pointer) noexcept {
+      if (!pointer) {
+        return nullptr;
+      }
+      const auto usable = UsableSize(pointer);
+      count_.fetch_add(1, std::memory_order_relaxed);
+      bytes_.fetch_add(usable, std::memory_order_relaxed);
+      const auto live = live_bytes_.fetch_add(usable, std::memory_order_relaxed) + usable;
+      auto peak = peak_live_bytes_.load(std::memory_order_relaxed);
+      while (live > peak && !peak_live_bytes_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+      }
+      return pointer;
+    }
+
+    void* Allocated(std::size_t size) noexcept {
+      return Counted(std::malloc(size == 0 ? 1 : size));
+    }
+
+    void* Allocated(std::size_t size, std::align_val_t alignment) noexcept {
+      void* pointer{nullptr};
+      const auto rounded = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+      return Counted(::posix_memalign(&pointer, rounded, size == 0 ? 1 : size) == 0 ? pointer : nullptr);
+    }
+
+    void Freed(void* pointer) noexcept {
+      if (pointer) {
+        live_bytes_.fetch_sub(UsableSize(pointer), std::memory_order_relaxed);
+        std::free(pointer);
+      }
+    }
+  } // anonymous namespace
+
+
+  Allocations AllocationsSoFar() noexcept {
+    return {
+        count_.load(std::memory_order_relaxed),
+        bytes_.load(std::memory_order_relaxed),
+        live_bytes_.load(std::memory_order_relaxed),
+        peak_live_bytes_.load(std::memory_order_relaxed)
+    };
+  }
+
+
+  void ResetPeakLiveBytes() noexcept {
+    peak_live_bytes_.store(live_bytes_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+
+
+  std::size_t PeakResidentBytes() noexcept {
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+  }
+} // Benchmark
+
+
+void* operator new(std::size_t size) {
+  if (auto* pointer = Benchmark::Allocated(size)) {
+    return pointer;
+  }
+  throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept {
+  return Benchmark::Allocated(size);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept {
+  return Benchmark::Allocated(size);
+}
+
+void operator delete(void* pointer) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete(void* pointer, std::nothrow_t const&) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete[](void* pointer, std::nothrow_t const&) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  if (auto* pointer = Benchmark::Allocated(size, alignment)) {
+    return pointer;
+  }
+  throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept {
+  return Benchmark::Allocated(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept {
+  return Benchmark::Allocated(size, alignment);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, std::nothrow_t const&) noexcept {
+  Benchmark::Freed(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, std::nothrow_t const&) noexcept {
+  Benchmark::Freed(pointer);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Benchmark {
+  // What went through operator new and delete since the program started.
+  // Bytes are as the allocator rounds them up, which is what the heap holds.
+  struct Allocations {
+    std::size_t count;
+    std::size_t bytes;
+    std::size_t live_bytes;
+    // The most live bytes since the last ResetPeakLiveBytes.
+    std::size_t peak_live_bytes;
+  };
+
+  Allocations AllocationsSoFar() noexcept;
+  void ResetPeakLiveBytes() noexcept;
+
+  // The peak resident set size of the whole process.
+  std::size_t PeakResidentBytes() noexcept;
+} // Benchmark
@@ -0,0 +1,170 @@
+#include "EditingTrace.h"
+#include <charconv>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+
+namespace Benchmark {
+  namespace {
+    constexpr Index DocumentSize{1 << 20};
+
+    [[noreturn]] void Fail(std::string const& path, std::size_t line, std::string const& what) {
+      throw std::runtime_error(path + ":" + std::to_string(line) + ": " + what);
+    }
+
+
+    // Takes a number and the space after it off the front of text.
+    bool TakeNumber(std::string_view& text, Index& number) {
+      const auto* end = text.data() + text.size();
+      const auto [next, error] = std::from_chars(text.data(), end, number);
+      if (error != std::errc{} || (next != end && *next != ' ')) {
+        return false;
+      }
+      text.remove_prefix(static_cast<std::size_t>(next - text.data()));
+      if (!text.empty()) {
+        text.remove_prefix(1);
+      }
+      return true;
+    }
+
+
+    bool Unescaped(std::string_view text, String& into) {
+      for (std::size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\\') {
+          into.push_back(text[i]);
+          continue;
+        }
+        if (++i == text.size()) {
+          return false;
+        }
+        switch (text[i]) {
+          case 'n': into.push_back('\n'); break;
+          case 't': into.push_back('\t'); break;
+          case '\\': into.push_back('\\'); break;
+          default: return false;
+        }
+      }
+      return true;
+    }
+
+
+    char TypedCharacter(std::mt19937& generator) {
+      std::uniform_int_distribution<int> key(0, 39);
+      const auto k = key(generator);
+      return k < 26 ? static_cast<char>('a' + k) : k < 38 ? ' ' : '\n';
+    }
+
+
+    // Lines of typed text, about 1 MB of them.
+    String Document(std::mt19937& generator) {
+      String document;
+      document.reserve(DocumentSize);
+      while (document.size() < DocumentSize) {
+        document.push_back(TypedCharacter(generator));
+      }
+      document.back() = '\n';
+      return document;
+    }
+  } // anonymous namespace
+
+
+  EditingTrace LoadedTrace(std::string const& path) {
+    std::ifstream file{path};
+    if (!file) {
+      throw std::runtime_error("cannot read the trace " + path);
+    }
+
+    EditingTrace trace;
+    trace.name = path;
+    std::string line;
+    for (std::size_t number = 1; std::getline(file, line); ++number) {
+      std::string_view text{line};
+      if (text.empty() || text.front() == '#') {
+        continue;
+      }
+      if (text.substr(0, 8) == "initial ") {
+        if (!Unescaped(text.substr(8), trace.initial)) {
+          Fail(path, number, "bad escape sequence");
+        }
+        continue;
+      }
+
+      Operation operation;
+      if (!TakeNumber(text, operation.position) || !TakeNumber(text, operation.removed)) {
+        Fail(path, number, "expected <position> <removed> <inserted>");
+      }
+      if (!Unescaped(text, operation.inserted)) {
+        Fail(path, number, "bad escape sequence");
+      }
+      trace.operations.push_back(std::move(operation));
+    }
+    if (file.bad()) {
+      throw std::runtime_error("cannot read the trace " + path);
+    }
+    return trace;
+  }
+
+
+  EditingTrace AppendingTrace(Index count, std::uint32_t seed) {
+    std::mt19937 generator{seed};
+    EditingTrace trace{"append", {}, {}};
+    trace.operations.reserve(count);
+    for (Index i = 0; i < count; ++i) {
+      trace.operations.push_back({i, 0, String(1, TypedCharacter(generator))});
+    }
+    return trace;
+  }
+
+
+  EditingTrace RandomTrace(Index count, std::uint32_t seed) {
+    std::mt19937 generator{seed};
+    EditingTrace trace{"random", Document(generator), {}};
+    trace.operations.reserve(count);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<Index> length(1, 8);
+    auto size = trace.initial.size();
+    for (Index i = 0; i < count; ++i) {
+      if (percent(generator) < 30 && size > 8) {
+        const auto removed = length(generator);
+        std::uniform_int_distribution<Index> position(0, size - removed);
+        trace.operations.push_back({position(generator), removed, {}});
+        size -= removed;
+      }
+      else {
+        std::uniform_int_distribution<Index> position(0, size);
+        trace.operations.push_back({position(generator), 0, String(1, TypedCharacter(generator))});
+        size += 1;
+      }
+    }
+    return trace;
+  }
+
+
+  EditingTrace ClusteredTrace(Index count, std::uint32_t seed) {
+    std::mt19937 generator{seed};
+    EditingTrace trace{"cluster", Document(generator), {}};
+    trace.operations.reserve(count);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<Index> session(10, 80);
+    auto size = trace.initial.size();
+    Index cursor{0};
+    Index keystrokes_left{0};
+    for (Index i = 0; i < count; ++i) {
+      if (keystrokes_left-- == 0) {
+        std::uniform_int_distribution<Index> position(0, size);
+        cursor = position(generator);
+        keystrokes_left = session(generator);
+      }
+      if (percent(generator) < 15 && cursor > 0) {
+        trace.operations.push_back({--cursor, 1, {}});
+        size -= 1;
+      }
+      else {
+        trace.operations.push_back({cursor++, 0, String(1, TypedCharacter(generator))});
+        size += 1;
+      }
+    }
+    return trace;
+  }
+} // Benchmark
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "TextModel/Buffer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Benchmark {
+  using TextModel::Index;
+  using TextModel::String;
+
+  // Removes removed bytes at position, then inserts inserted there.
+  struct Operation {
+    Index position;
+    Index removed;
+    String inserted;
+  };
+
+  struct EditingTrace {
+    std::string name;
+    String initial;
+    std::vector<Operation> operations;
+  };
+
+
+  // Reads a recorded trace, one operation per line:
+  //
+  //   <position> <removed> <inserted>
+  //
+  // with positions in bytes and \n, \t and \\ escaped in the inserted text.
+  // Lines starting with "initial " append the rest to the starting text,
+  // which is empty otherwise, and lines starting with # are comments. The
+  // patches of a [position, removed, inserted] keystroke log map to it line
+  // by line, once their offsets are converted to bytes; traces/note.trace is
+  // a small example. Throws std::runtime_error for files that cannot be read
+  // or do not parse.
+  EditingTrace LoadedTrace(std::string const& path);
+
+
+  // Synthetic workloads of operations editing count bytes or fewer each, the
+  // same for the same seed.
+
+  // Typing a document from scratch: only appending, a line break now and
+  // then.
+  EditingTrace AppendingTrace(Index count, std::uint32_t seed);
+
+  // Single byte insertions and short removals anywhere in a 1 MB document.
+  EditingTrace RandomTrace(Index count, std::uint32_t seed);
+
+  // Editing sessions in a 1 MB document: typing and backspacing at a cursor
+  // that jumps elsewhere every few dozen keystrokes.
+  EditingTrace ClusteredTrace(Index count, std::uint32_t seed);
+} // Benchmark
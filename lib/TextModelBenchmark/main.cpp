@@ -0,0 +1,339 @@
+#include "Allocations.h"
+#include "EditingTrace.h"
+#include "TextModel/TextBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Replays editing traces against buffers and reports what every operation
+// cost: latency percentiles, throughput, allocations and memory. Run it
+// from a Release build; --json writes a line of JSON per replay for
+// tracking regressions.
+
+namespace Benchmark {
+  namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // The Buffer implementations to replay against.
+    struct BufferKind {
+      std::string name;
+      std::function<std::unique_ptr<TextModel::Buffer>(String)> make;
+    };
+
+    std::vector<BufferKind> const& BufferKinds() {
+      static const std::vector<BufferKind> kinds{
+          {"TextBuffer", [](String initial) {
+            return std::make_unique<TextModel::TextBuffer>(std::move(initial));
+          }},
+      };
+      return kinds;
+    }
+
+
+    struct Options {
+      Index operations{100000};
+      std::uint32_t seed{25};
+      bool json{false};
+      bool help{false};
+      std::vector<std::string> workloads;
+      std::vector<std::string> traces;
+      std::vector<std::string> buffers;
+    };
+
+
+    struct Result {
+      std::string buffer;
+      std::string trace;
+      Index operations;
+      double seconds;
+      // Latencies of single operations, in nanoseconds.
+      double p50;
+      double p90;
+      double p99;
+      double p999;
+      double max;
+      std::size_t allocations;
+      std::size_t allocated_bytes;
+      // Above what the buffer held before the first operation.
+      std::size_t peak_heap_bytes;
+      std::size_t peak_resident_bytes;
+    };
+
+
+    double Percentile(std::vector<double> const& sorted, double fraction) {
+      if (sorted.empty()) {
+        return 0;
+      }
+      const auto rank = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+      return sorted[rank];
+    }
+
+
+    // Throws std::logic_error when the buffer does not end up as long as the
+    // trace says.
+    Result Replayed(BufferKind const& kind, EditingTrace const& trace) {
+      auto buffer = kind.make(trace.initial);
+      std::vector<double> latencies(trace.operations.size());
+      auto expected_size = trace.initial.size();
+
+      ResetPeakLiveBytes();
+      const auto before = AllocationsSoFar();
+      const auto start = Clock::now();
+      for (std::size_t i = 0; i < trace.operations.size(); ++i) {
+        auto const& operation = trace.operations[i];
+        const auto operation_start = Clock::now();
+        if (operation.removed > 0) {
+          buffer->remove({operation.position, operation.position + operation.removed});
+        }
+        if (!operation.inserted.empty()) {
+          buffer->insert(operation.position, operation.inserted);
+        }
+        latencies[i] = std::chrono::duration<double, std::nano>(Clock::now() - operation_start).count();
+        expected_size += operation.inserted.size() - operation.removed;
+      }
+      const auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+      const auto after = AllocationsSoFar();
+
+      if (buffer->size() != expected_size) {
+        throw std::logic_error(
+            kind.name + " replaying " + trace.name + " ends up " + std::to_string(buffer->size())
+            + " bytes long instead of " + std::to_string(expected_size)
+        );
+      }
+
+      std::sort(latencies.begin(), latencies.end());
+      return {
+          kind.name, trace.name, trace.operations.size(), seconds,
+          Percentile(latencies, 0.5), Percentile(latencies, 0.9),
+          Percentile(latencies, 0.99), Percentile(latencies, 0.999),
+          latencies.empty() ? 0 : latencies.back(),
+          after.count - before.count, after.bytes - before.bytes,
+          after.peak_live_bytes - before.live_bytes,
+          PeakResidentBytes()
+      };
+    }
+
+
+    // Names and paths are printed as they are, but for quotes, backslashes
+    // and control characters, which JSON has to have escaped.
+    std::string Quoted(std::string const& text) {
+      std::string quoted{"\""};
+      for (const auto c : text) {
+        if (c == '"' || c == '\\') {
+          quoted.push_back('\\');
+          quoted.push_back(c);
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[7];
+          std::snprintf(escaped, sizeof escaped, "\\u%04X", static_cast<unsigned>(c));
+          quoted += escaped;
+        }
+        else {
+          quoted.push_back(c);
+        }
+      }
+      quoted.push_back('"');
+      return quoted;
+    }
+
+
+    void PrintJson(Result const& result) {
+      std::printf(
+          "{\"buffer\":%s,\"trace\":%s,\"operations\":%zu,\"seconds\":%.6f,"
+          "\"operations_per_second\":%.1f,"
+          "\"latency_ns\":{\"p50\":%.0f,\"p90\":%.0f,\"p99\":%.0f,\"p99.9\":%.0f,\"max\":%.0f},"
+          "\"allocations\":%zu,\"allocated_bytes\":%zu,"
+          "\"peak_heap_bytes\":%zu,\"peak_resident_bytes\":%zu}\n",
+          Quoted(result.buffer).c_str(), Quoted(result.trace).c_str(),
+          result.operations, result.seconds,
+          static_cast<double>(result.operations) / result.seconds,
+          result.p50, result.p90, result.p99, result.p999, result.max,
+          result.allocations, result.allocated_bytes,
+          result.peak_heap_bytes, result.peak_resident_bytes
+      );
+    }
+
+
+    void PrintHeader() {
+      std::printf(
+          "%-12s %-10s %9s %11s %9s %9s %9s %9s %9s %10s %10s %10s\n",
+          "buffer", "trace", "ops", "ops/s",
+          "p50 us", "p90 us", "p99 us", "p99.9 us", "max us",
+          "allocs/op", "heap MB", "rss MB"
+      );
+    }
+
+
+    void PrintRow(Result const& result) {
+      constexpr double Megabyte{1 << 20};
+      std::printf(
+          "%-12s %-10s %9zu %11.0f %9.2f %9.2f %9.2f %9.2f %9.1f %10.2f %10.1f %10.1f\n",
+          result.buffer.c_str(), result.trace.c_str(), result.operations,
+          static_cast<double>(result.operations) / result.seconds,
+          result.p50 / 1000, result.p90 / 1000, result.p99 / 1000, result.p999 / 1000,
+          result.max / 1000,
+          result.operations == 0 ? 0 : static_cast<double>(result.allocations) / static_cast<double>(result.operations),
+          static_cast<double>(result.peak_heap_bytes) / Megabyte,
+          static_cast<double>(result.peak_resident_bytes) / Megabyte
+      );
+    }
+
+
+    void PrintUsage(std::ostream& out) {
+      out << "Usage: TextModelBenchmark [options]\n"
+          << "\n"
+          << "  --workload NAME   replay a synthetic workload: append, random or cluster\n"
+          << "                    (all of them unless a trace is given)\n"
+          << "  --trace PATH      replay a recorded trace (see EditingTrace.h for the format)\n"
+          << "  --buffer NAME     replay against one buffer only: TextBuffer\n"
+          << "  --operations N    operations per synthetic workload (100000)\n"
+          << "  --seed N          seed of the synthetic workloads (25)\n"
+          << "  --json            write a line of JSON per replay\n"
+          << "  --help            print this\n";
+    }
+
+
+    // Throws std::invalid_argument for arguments it does not understand.
+    Options ParsedOptions(int argc, char** argv) {
+      Options options;
+      for (int i = 1; i < argc; ++i) {
+        const std::string argument{argv[i]};
+        const auto value = [&]() -> std::string {
+          if (i + 1 == argc) {
+            throw std::invalid_argument(argument + " needs a value");
+          }
+          return argv[++i];
+        };
+        const auto number = [&]() {
+          const auto text = value();
+          char* end{nullptr};
+          const auto parsed = std::strtoull(text.c_str(), &end, 10);
+          if (text.empty() || *end != '\0') {
+            throw std::invalid_argument(argument + " needs a number, not " + text);
+          }
+          return parsed;
+        };
+
+        if (argument == "--workload") {
+          options.workloads.push_back(value());
+          if (options.workloads.back() != "append" && options.workloads.back() != "random"
+              && options.workloads.back() != "cluster") {
+            throw std::invalid_argument("unknown workload " + options.workloads.back());
+          }
+        }
+        else if (argument == "--trace") {
+          options.traces.push_back(value());
+        }
+        else if (argument == "--buffer") {
+          options.buffers.push_back(value());
+        }
+        else if (argument == "--operations") {
+          options.operations = number();
+        }
+        else if (argument == "--seed") {
+          options.seed = static_cast<std::uint32_t>(number());
+        }
+        else if (argument == "--json") {
+          options.json = true;
+        }
+        else if (argument == "--help") {
+          options.help = true;
+        }
+        else {
+          throw std::invalid_argument("unknown argument " + argument);
+        }
+      }
+      if (options.workloads.empty() && options.traces.empty()) {
+        options.workloads = {"append", "random", "cluster"};
+      }
+      return options;
+    }
+
+
+    EditingTrace Workload(std::string const& name, Options const& options) {
+      if (name == "append") {
+        return AppendingTrace(options.operations, options.seed);
+      }
+      else if (name == "random") {
+        return RandomTrace(options.operations, options.seed);
+      }
+      else if (name == "cluster") {
+        return ClusteredTrace(options.operations, options.seed);
+      }
+      else {
+        throw std::invalid_argument("unknown workload " + name);
+      }
+    }
+
+
+    std::vector<BufferKind> SelectedBuffers(Options const& options) {
+      if (options.buffers.empty()) {
+        return BufferKinds();
+      }
+      std::vector<BufferKind> selected;
+      for (auto const& name : options.buffers) {
+        const auto kind = std::find_if(BufferKinds().begin(), BufferKinds().end(),
+            [&name](BufferKind const& k) { return k.name == name; }
+        );
+        if (kind == BufferKinds().end()) {
+          throw std::invalid_argument("unknown buffer " + name);
+        }
+        selected.push_back(*kind);
+      }
+      return selected;
+    }
+  } // anonymous namespace
+} // Benchmark
+
+
+int main(int argc, char** argv) {
+  using namespace Benchmark;
+
+  Options options;
+  std::vector<BufferKind> buffers;
+  try {
+    options = ParsedOptions(argc, argv);
+    buffers = SelectedBuffers(options);
+  }
+  catch (std::invalid_argument const& error) {
+    std::cerr << "TextModelBenchmark: " << error.what() << "\n\n";
+    PrintUsage(std::cerr);
+    return 2;
+  }
+  if (options.help) {
+    PrintUsage(std::cout);
+    return 0;
+  }
+
+  try {
+    std::vector<EditingTrace> traces;
+    for (auto const& name : options.workloads) {
+      traces.push_back(Workload(name, options));
+    }
+    for (auto const& path : options.traces) {
+      traces.push_back(LoadedTrace(path));
+    }
+
+    if (!options.json) {
+      PrintHeader();
+    }
+    for (auto const& trace : traces) {
+      for (auto const& kind : buffers) {
+        const auto result = Replayed(kind, trace);
+        options.json ? PrintJson(result) : PrintRow(result);
+        std::fflush(stdout);
+      }
+    }
+  }
+  catch (std::exception const& error) {
+    std::cerr << "TextModelBenchmark: " << error.what() << "\n";
+    return 1;
+  }
+}